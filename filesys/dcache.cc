@@ -0,0 +1,343 @@
+// dcache.cc
+//	Routines to manage the directory entry cache.  See dcache.h.
+//
+//	The cache is small and of fixed size, so it is searched
+//	linearly; the cost of a lookup does not depend on how many
+//	files or directories the file system holds.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "dcache.h"
+#include "system.h"
+
+// The cache the flush timer may still go off for.  The timer cannot be
+// cancelled, and Nachos may wait for the disk while halting, after the
+// cache is gone.
+
+static DentryCache *liveCache = NULL;
+
+//----------------------------------------------------------------------
+// DirFlushTimeout, DirFlushDaemon
+// 	The flush timer interrupt handler, and the flusher thread.  Need
+//	these to be C routines, because C++ can't handle pointers to
+//	member functions.
+//----------------------------------------------------------------------
+
+static void
+DirFlushTimeout(int arg)
+{
+    if ((DentryCache *) arg == liveCache)
+	((DentryCache *) arg)->FlushTimeout();
+}
+
+static void
+DirFlushDaemon(int arg)
+{
+    ((DentryCache *) arg)->FlushDaemon();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize the cache; initially it is empty.
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache()
+{
+    for (int i = 0; i < DcacheSize; i++) {
+	entries[i].sector = -1;
+	entries[i].file = NULL;
+	entries[i].dir = NULL;
+	entries[i].refCount = 0;
+	entries[i].stale = FALSE;
+	entries[i].dirty = FALSE;
+	entries[i].lock = new RWLock("directory lock");
+    }
+    useClock = 0;
+    flushNeeded = new Semaphore("directory flush", 0);
+    flusherForked = FALSE;
+    flushPending = FALSE;
+    liveCache = this;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the cache, writing back the directories that are
+//	dirty, and closing the directory files.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    Flush();
+    liveCache = NULL;
+    for (int i = 0; i < DcacheSize; i++) {
+	if (entries[i].sector != -1)
+	    Free(&entries[i]);
+	delete entries[i].lock;
+    }
+    delete flushNeeded;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Return the entry for the directory "path", with one more user,
+//	or NULL if it is not cached.
+//----------------------------------------------------------------------
+
+Dentry *
+DentryCache::Lookup(char *path)
+{
+    for (int i = 0; i < DcacheSize; i++) {
+	Dentry *d = &entries[i];
+
+	if (d->sector != -1 && !d->stale && !strcmp(d->path, path)) {
+	    d->refCount++;
+	    d->lastUsed = ++useClock;
+	    return d;
+	}
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	Read the directory "path" in from the file whose header is at
+//	"sector", and cache it.  Return the new entry, with one user.
+//
+//	Reading the directory waits for the disk, and somebody else may
+//	cache the same directory meanwhile; if so, use their copy, so
+//	that there is never more than one copy of a directory in memory.
+//
+//	If every entry is held, wait for one to be let go.  The slot
+//	chosen is held while the directory in it is closed, which may
+//	wait too, so that nobody else takes it, or finds the old one.
+//----------------------------------------------------------------------
+
+Dentry *
+DentryCache::Enter(char *path, int sector)
+{
+    OpenFile *file = new OpenFile(sector);
+    Directory *dir = new Directory(NumDirEntries);
+    Dentry *victim = NULL;
+    Dentry *d;
+
+    ASSERT(strlen(path) <= PathMaxLen);
+    dir->FetchFrom(file);
+    for (;;) {
+	if ((d = Lookup(path)) != NULL) {
+	    delete dir;
+	    delete file;
+	    return d;
+	}
+
+	victim = NULL;
+	for (int i = 0; i < DcacheSize; i++) {
+	    d = &entries[i];
+	    if (d->refCount > 0)
+		continue;
+	    if (d->sector == -1) {
+		victim = d;
+		break;
+	    }
+	    if (victim == NULL || d->lastUsed < victim->lastUsed)
+		victim = d;
+	}
+	if (victim == NULL) {
+	    currentThread->Yield();	// every directory is in use
+	    continue;
+	}
+	if (victim->sector == -1 || !victim->dirty)
+	    break;
+	WriteBack(victim);		// waited; look again
+    }
+    victim->refCount = 1;
+    if (victim->sector != -1)
+	Free(victim);
+
+    strcpy(victim->path, path);
+    victim->sector = sector;
+    victim->file = file;
+    victim->dir = dir;
+    victim->refCount = 1;
+    victim->lastUsed = ++useClock;
+    victim->stale = FALSE;
+    victim->dirty = FALSE;
+    DEBUG('f', "Cached directory %s, header at sector %d\n", path, sector);
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Release
+// 	"dentry" is no longer used by the caller.  It stays cached, unless
+//	its directory has been removed.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Release(Dentry *dentry)
+{
+    ASSERT(dentry->refCount > 0);
+    if (--dentry->refCount == 0 && dentry->stale)
+	Free(dentry);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Purge
+// 	The directory "path" is being removed.  Forget it and every
+//	directory below it; entries still in use are freed when they are
+//	released.
+//
+//	Then wait for whoever holds the lock of one of those, such as a
+//	Create in it, to be done: from then on, anybody who takes the
+//	lock finds the entry stale, and leaves the directory alone, so
+//	that the caller can free its sectors.  The caller holds the lock
+//	of the parent; nobody waits for that while holding the lock of a
+//	directory below it.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Purge(char *path)
+{
+    int len = strlen(path);
+
+    for (int i = 0; i < DcacheSize; i++) {
+	Dentry *d = &entries[i];
+
+	if (d->sector == -1 || strncmp(d->path, path, len))
+	    continue;
+	if (d->refCount == 0)
+	    Free(d);
+	else
+	    d->stale = TRUE;
+    }
+    for (int i = 0; i < DcacheSize; i++) {
+	Dentry *d = &entries[i];
+
+	if (d->sector == -1 || !d->stale || strncmp(d->path, path, len))
+	    continue;
+	d->refCount++;
+	d->lock->AcquireWLock();
+	d->lock->ReleaseLock();
+	Release(d);
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::MarkDirty
+// 	The caller has changed "dentry"'s directory in memory only.  Make
+//	sure it is written back within DirFlushInterval ticks.  As with the
+//	sector cache, the timer only runs while something is dirty, so
+//	that an idle machine can still halt.
+//----------------------------------------------------------------------
+
+void
+DentryCache::MarkDirty(Dentry *dentry)
+{
+    dentry->dirty = TRUE;
+    stats->numDirUpdatesDeferred++;
+    if (flushPending)
+	return;
+    if (!flusherForked) {
+	Thread *t = new Thread("directory flusher");
+
+	flusherForked = TRUE;
+	t->Fork(DirFlushDaemon, (int) this);
+    }
+    flushPending = TRUE;
+    interrupt->Schedule(DirFlushTimeout, (int) this, DirFlushInterval,
+								TimerInt);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Flush
+// 	Write back every dirty directory, except those removed.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Flush()
+{
+    for (int i = 0; i < DcacheSize; i++) {
+	Dentry *d = &entries[i];
+
+	if (d->sector != -1 && d->dirty && !d->stale)
+	    WriteBack(d);
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::FlushDaemon
+// 	Body of the flusher thread: each time the flush timer goes off,
+//	write the dirty directories back.
+//----------------------------------------------------------------------
+
+void
+DentryCache::FlushDaemon()
+{
+    for (;;) {
+	flushNeeded->P();
+	DEBUG('f', "Flushing dirty directories\n");
+	Flush();
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::FlushTimeout
+// 	Flush timer interrupt handler.  Can't do disk I/O here, so just
+//	wake up the flusher thread.
+//----------------------------------------------------------------------
+
+void
+DentryCache::FlushTimeout()
+{
+    flushPending = FALSE;
+    flushNeeded->V();
+}
+
+//----------------------------------------------------------------------
+// DentryCache::WriteBack
+// 	Write a dirty directory back, holding the entry while waiting
+//	for the disk.  A change made meanwhile makes it dirty again.  A
+//	directory removed meanwhile is not written: its sectors are free.
+//----------------------------------------------------------------------
+
+void
+DentryCache::WriteBack(Dentry *dentry)
+{
+    dentry->refCount++;
+    journal->Begin();
+    dentry->lock->AcquireRLock();
+    if (!dentry->stale) {
+	dentry->dirty = FALSE;
+	dentry->dir->WriteBack(dentry->file);
+    }
+    dentry->lock->ReleaseLock();
+    journal->End();
+    stats->numDirWriteBacks++;
+    Release(dentry);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Free
+// 	Close the directory file of an entry, and mark the slot free.
+//	Whatever it had not written back is lost, so it must be clean,
+//	or removed.
+//
+//	Closing the file may wait for the disk, so the slot is emptied
+//	first; nobody can find the old directory in it meanwhile.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Free(Dentry *dentry)
+{
+    Directory *dir = dentry->dir;
+    OpenFile *file = dentry->file;
+
+    dentry->dir = NULL;
+    dentry->file = NULL;
+    dentry->sector = -1;
+    dentry->stale = FALSE;
+    dentry->dirty = FALSE;
+    delete dir;
+    delete file;
+}
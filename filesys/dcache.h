@@ -0,0 +1,92 @@
+// dcache.h
+//	Data structures for the directory entry cache ("dentry cache").
+//
+//	Resolving a path like "/a/b/" means reading the root directory,
+//	finding "a" in it, reading that directory, and so on.  The cache
+//	remembers the directories reached that way, by their full path,
+//	together with their contents already read into memory.  A path
+//	that is cached costs no disk reads at all to resolve; one that is
+//	not is resolved from its longest cached prefix.
+//
+//	A cached directory is held while somebody is using it, and is
+//	only replaced (least recently used first) when nobody is.  Its
+//	contents are protected by a reader/writer lock of its own: looking
+//	a name up, listing, and writing the directory back share it, and
+//	adding or removing a file, or changing an open count or access
+//	time, hold it alone, so threads working in different directories
+//	never wait for each other.
+//	Directories are written back as soon as a file is added or
+//	removed.  Changes that need not survive a crash -- access times
+//	and open counts -- are only made in memory, and the directory is
+//	marked dirty; dirty directories are written back together, by a
+//	flusher thread at most DirFlushInterval ticks later, when they
+//	are replaced, or when Nachos halts.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include "copyright.h"
+#include "openfile.h"
+#include "directory.h"
+#include "synch.h"
+
+#define DcacheSize 	16	// directories kept in memory
+#define PathMaxLen 	99	// longest path, not counting the '\0'
+#define DirFlushInterval 50000	// most ticks a directory stays dirty
+
+// The following class defines one cached directory.
+
+class Dentry {
+  public:
+    char path[PathMaxLen + 1];		// full path, such as "/a/b/"
+    int sector;				// header of the directory file,
+					// or -1 if the slot is free
+    OpenFile *file;			// the directory file, kept open
+    Directory *dir;			// its contents
+    int refCount;			// users holding the entry
+    int lastUsed;			// for LRU replacement
+    bool stale;				// directory removed; free the entry
+					// once the last user lets go
+    bool dirty;				// changed since last written back?
+    RWLock *lock;			// protects "dir"; a journal
+					// transaction is begun before it is
+					// taken, never while it is held
+};
+
+// The following class defines the cache of directories.
+
+class DentryCache {
+  public:
+    DentryCache();
+    ~DentryCache();
+
+    Dentry *Lookup(char *path);		// Return the cached directory
+					// "path", held, or NULL
+    Dentry *Enter(char *path, int sector);
+					// Read in the directory "path",
+					// whose header is at "sector"; held
+    void Release(Dentry *dentry);	// Let go of an entry
+    void Purge(char *path);		// Forget "path" and everything
+					// below it
+    void MarkDirty(Dentry *dentry);	// The directory changed in memory;
+					// write it back later
+    void Flush();			// Write back every dirty directory
+    void FlushDaemon();			// Body of the flusher thread
+    void FlushTimeout();		// Called by the flush timer interrupt
+
+  private:
+    Dentry entries[DcacheSize];
+    int useClock;			// advances on every use
+    Semaphore *flushNeeded;		// the flusher thread waits here
+    bool flusherForked;			// Has the flusher thread started?
+    bool flushPending;			// Is the flush timer running?
+
+    void WriteBack(Dentry *dentry);	// Write a dirty directory back
+    void Free(Dentry *dentry);		// Empty a slot
+};
+
+#endif // DCACHE_H
@@ -11,10 +11,9 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	When every entry is in use, Add doubles the size of the table;
+//	the directory file grows to match the next time it is written
+//	back.  FetchFrom sizes the table from the length of the file.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -39,16 +38,13 @@
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    //currentPath = "/";
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
-
-    FileOpenThreads = new int[tableSize];
-
-    for (int i=0; i<tableSize; i++)
-        FileOpenThreads[i] = 0;
+    table = NULL;
+    bucket = NULL;
+    nextInChain = NULL;
+    tableSize = 0;
+    firstDirty = 0;
+    lastDirty = -1;
+    Resize(size);			// all of it is new, so dirty
 }
 
 //----------------------------------------------------------------------
@@ -59,11 +55,52 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] bucket;
+    delete [] nextInChain;
 } 
 
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Make the table hold "size" entries, keeping the ones in use (they
+//	must all fit), and re-index it.  New entries are not in use.
+//----------------------------------------------------------------------
+
+void
+Directory::Resize(int size)
+{
+    DirectoryEntry *oldTable = table;
+    int oldSize = tableSize;
+
+    if (size < 1)
+	size = 1;
+    table = new DirectoryEntry[size];
+    tableSize = size;
+    for (int i = 0; i < tableSize; i++) {
+	if (i < oldSize)
+	    table[i] = oldTable[i];
+	else
+	    table[i].inUse = FALSE;
+    }
+    for (int i = tableSize; i < oldSize; i++)
+	ASSERT(!oldTable[i].inUse);
+    delete [] oldTable;
+    if (lastDirty >= tableSize)
+	lastDirty = tableSize - 1;
+    if (tableSize > oldSize)
+	Touch(oldSize, tableSize - 1);	// the file must grow to match
+
+    delete [] bucket;
+    delete [] nextInChain;
+    numBuckets = tableSize;		// keep the chains short on average
+    bucket = new int[numBuckets];
+    nextInChain = new int[tableSize];
+    BuildIndex();
+}
+
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk, and index them.
+//	There are as many entries as fit in the file.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -71,24 +108,124 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
-    (void) file->ReadAt((char *)FileOpenThreads, tableSize * sizeof(int),  tableSize * sizeof(DirectoryEntry));
-        //int *FileOpenThreads;
+    int size = file->Length() / sizeof(DirectoryEntry);
 
+    if (size != tableSize) {
+	delete [] table;
+	table = NULL;
+	tableSize = 0;
+	Resize(size);
+    }
+    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    BuildIndex();
+    firstDirty = tableSize;
+    lastDirty = -1;
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Return
+//	FALSE if the file could not grow to hold a larger table.
+//
+//	Only the run of entries from the first to the last that changed
+//	since the table was last read or written is written, so adding
+//	or removing a file costs a few sectors, however big the
+//	directory.  The file is flushed (cf. OpenFile::Flush), so that
+//	the write, and the header of a file that grew, are part of the
+//	caller's transaction.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
-void
+bool
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
-    (void) file->WriteAt((char *)FileOpenThreads, tableSize * sizeof(int),  tableSize * sizeof(DirectoryEntry));
+    int size, position;
+
+    if (firstDirty > lastDirty)
+	return TRUE;			// nothing changed
+    size = (lastDirty - firstDirty + 1) * sizeof(DirectoryEntry);
+    position = firstDirty * sizeof(DirectoryEntry);
+    if (file->WriteAt((char *)&table[firstDirty], size, position) != size)
+	return FALSE;			// still dirty
+    file->Flush();
+    firstDirty = tableSize;
+    lastDirty = -1;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Touch
+// 	Note that entries "first" to "last" have changed, and must be
+//	written by the next WriteBack.
+//----------------------------------------------------------------------
+
+void
+Directory::Touch(int first, int last)
+{
+    if (first < firstDirty)
+	firstDirty = first;
+    if (last > lastDirty)
+	lastDirty = last;
+}
+
+//----------------------------------------------------------------------
+// Directory::Hash
+// 	Return the hash chain for the entry named "name".  Only the first
+//	FileNameMaxLen characters of the name count, since that is all an
+//	entry keeps.
+//----------------------------------------------------------------------
+
+int
+Directory::Hash(char *name)
+{
+    unsigned int h = 0;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+	h = h * 31 + (unsigned char) name[i];
+    return h % numBuckets;
+}
+
+//----------------------------------------------------------------------
+// Directory::BuildIndex
+// 	Rebuild the hash index from scratch, from the entries in use.
+//----------------------------------------------------------------------
+
+void
+Directory::BuildIndex()
+{
+    for (int i = 0; i < numBuckets; i++)
+	bucket[i] = -1;
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse)
+	    IndexEntry(i);
+}
+
+//----------------------------------------------------------------------
+// Directory::IndexEntry/UnindexEntry
+// 	Add table[i] to the hash index, or take it out again.  Called
+//	whenever an entry starts or stops being in use.
+//----------------------------------------------------------------------
+
+void
+Directory::IndexEntry(int i)
+{
+    int h = Hash(table[i].name);
+
+    nextInChain[i] = bucket[h];
+    bucket[h] = i;
+}
+
+void
+Directory::UnindexEntry(int i)
+{
+    int *link = &bucket[Hash(table[i].name)];
+
+    while (*link != i) {
+	ASSERT(*link != -1);		// must be on its chain
+	link = &nextInChain[*link];
+    }
+    *link = nextInChain[i];
 }
 
 //----------------------------------------------------------------------
@@ -96,23 +233,18 @@ Directory::WriteBack(OpenFile *file)
 // 	Look up file name in directory, and return its location in the table of
 //	directory entries.  Return -1 if the name isn't in the directory.
 //
+//	Only the entries on the name's hash chain are compared.
+//
 //	"name" -- the file name to look up
 //----------------------------------------------------------------------
 
 int
-Directory::FindIndex(char *targetPath, char *name)
+Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen) &&  !strcmp(targetPath, table[i].path))
+    for (int i = bucket[Hash(name)]; i != -1; i = nextInChain[i])
+        if (!strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
     return -1;		// name not in directory
-    // for(int i=0; i<tableSize; i++)
-    // {
-    //     if(table[i].inUse && strcmp(table[i].path, targetPath) && 
-    //         strcmp(table[i].name, name))
-    //     return i;
-    // }
-    // return -1;
 }
 
 //----------------------------------------------------------------------
@@ -125,125 +257,119 @@ Directory::FindIndex(char *targetPath, char *name)
 //----------------------------------------------------------------------
 
 int
-Directory::Find(char *targetPath, char *name)
+Directory::Find(char *name)
 {
-    int i = FindIndex(targetPath, name);
+    int i = FindIndex(name);
 
     if (i != -1)
-    {
-        //updateTime(table[i].lastVisited);
         return table[i].sector;
-    }
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Directory::IsDirectory
+// 	Return TRUE if "name" is in the directory, and is a directory
+//	itself.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsDirectory(char *name)
+{
+    int i = FindIndex(name);
+
+    return i != -1 && table[i].type == 'd';
+}
+
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.
+//	If the directory is full, the table is made bigger.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"type" -- 'f' for a file, 'd' for a directory
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector, char type, char *targetPath)
+Directory::Add(char *name, int newSector, char type)
 { 
-    
-    for(int i=0; i<tableSize; i++)
-    {
-        if(table[i].inUse && !strcmp(table[i].path, targetPath) && 
-             !strcmp(table[i].name, name))
-            return FALSE;
-    }
+    int i;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            //table[i].name = name;
-            //table[i].path = targetPath;
-            strncpy(table[i].path, targetPath, 100);
-            table[i].type = type;
-            table[i].sector = newSector;
-            table[i].threadNumber = 0;
-            updateTime(table[i].createTime);
-            updateTime(table[i].lastVisited);
-            updateTime(table[i].lastModified);
-            printf("file named %s has been successfully added to table[%d]\n", name, i);
+    if (FindIndex(name) != -1)
+        return FALSE;
 
-            return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    for (i = 0; i < tableSize; i++)
+        if (!table[i].inUse)
+            break;
+    if (i == tableSize)
+        Resize(2 * tableSize);		// full; i is the first new entry
+
+    table[i].inUse = TRUE;
+    strncpy(table[i].name, name, FileNameMaxLen);
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].type = type;
+    table[i].sector = newSector;
+    table[i].openThreads = 0;
+    updateTime(table[i].createTime);
+    strcpy(table[i].lastVisited, table[i].createTime);
+    strcpy(table[i].lastModified, table[i].createTime);
+    IndexEntry(i);
+    Touch(i, i);
+    DEBUG('f', "Added %s to directory entry %d\n", name, i);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::Remove
 // 	Remove a file name from the directory.  Return TRUE if successful;
-//	return FALSE if the file isn't in the directory. 
+//	return FALSE if the file isn't in the directory.  Removing a
+//	directory's entry does not touch what is inside it; that is up
+//	to the caller.
 //
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 
 bool
-Directory::Remove(char *targetPath, char *name)
+Directory::Remove(char *name)
 { 
-    // int index = FindIndex(targetPath, name);
-    // if (index == -1)
-    //     return FALSE;       // name not in directory
-    int index = -1;
-    for(int i=0; i<tableSize; i++)
-    {
-        if(table[i].inUse && !strcmp(table[i].path, targetPath) && 
-             !strcmp(table[i].name, name))
-        {
-            index = i;
-            break;
-        }
-    }
-    if(index == -1)
-        return FALSE;
-    if(table[index].type == 'f')            //delete a file
-    {
-        table[index].inUse = FALSE;
-        return TRUE; 
-    }
-    else                                    //delete a directory
-    {
-        char *fullPath = new char[100];
-        memset(fullPath, 0, sizeof fullPath);
-        strcat(fullPath, targetPath);
-        strcat(fullPath, name);
-        strcat(fullPath, "/");
-        int len = strlen(fullPath);
-        table[index].inUse = FALSE;
-        for(int i=0; i<tableSize; i++)
-        {
-            if(table[i].inUse && !strncmp(table[i].path, fullPath, len))
-            {
-               table[i].inUse = FALSE;
-            }
-        }
-        delete fullPath;
-    }
-    
+    int index = FindIndex(name);
+
+    if (index == -1)
+        return FALSE;       // name not in directory
+    UnindexEntry(index);
+    table[index].inUse = FALSE;
+    Touch(index, index);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if no entry is in use.
+//----------------------------------------------------------------------
 
-    
+bool
+Directory::IsEmpty()
+{
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse)
+	    return FALSE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory, each prefixed with
+//	"path", the path of the directory itself.
 //----------------------------------------------------------------------
 
 void
-Directory::List()
+Directory::List(char *path)
 {
    for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+	    printf("%s%s%s\n", path, table[i].name,
+				table[i].type == 'd' ? "/" : "");
 }
 
 //----------------------------------------------------------------------
@@ -260,16 +386,13 @@ Directory::Print()
     printf("Directory contents:\n");
     for (int i = 0; i < tableSize; i++)
     {
-        //printf("now is is %d\n", i);
         if (table[i].inUse) 
         {
-            //printf("and now table[%d] is inUse\n", i);
             printf("\n");
             printf("***************************************\n");
             printf("Name: %s\n", table[i].name);
-            printf("Path: %s\n", table[i].path);
+            printf("Type: %c\n", table[i].type);
             printf("Sector: %d\n", table[i].sector);
-            //printf("Name: %s, Path: %s, Sector: %d\n", table[i].name, table[i].path, table[i].sector);
             printf("createTime: %s, lastVisited: %s, lastModified %s\n", 
                 table[i].createTime, table[i].lastVisited, table[i].lastModified);
             hdr->FetchFrom(table[i].sector);
@@ -284,162 +407,162 @@ Directory::Print()
     delete hdr;
 }
 
+//----------------------------------------------------------------------
+// FormatTime
+// 	Write "when" into "into", a 25 byte time field of an entry, in
+//	the format of asctime.
+//----------------------------------------------------------------------
 
- void 
- Directory::addThread(char *targetPath, char *name)
- {
-    int i = FindIndex(targetPath, name);
-    table[i].threadNumber++;
- }
+static void
+FormatTime(char *into, time_t when)
+{
+    strncpy(into, asctime(localtime(&when)), 24);
+    into[24] = '\0';
+}
 
 void 
-Directory::subThread(char *targetPath, char *name)
+Directory::updateTime(char needUpdate[])
 {
-    int i = FindIndex(targetPath, name);
-    table[i].threadNumber--;
+    FormatTime(needUpdate, time(NULL));
 }
 
-int 
-Directory::getThread(char *targetPath, char *name)
+void 
+Directory::updateVisitedTime(char *name)
 {
-    int i = FindIndex(targetPath, name);
-    return table[i].threadNumber;
+    int i = FindIndex(name);
+    updateTime(table[i].lastVisited);
+    Touch(i, i);
 }
 
-void 
-Directory::updateTime(char needUpdate[])
+//----------------------------------------------------------------------
+// ParseTime
+// 	Return the time written by updateTime into "when", in the format
+//	of asctime, or 0 if it cannot be read.
+//----------------------------------------------------------------------
+
+static time_t
+ParseTime(char *when)
 {
-    time_t rawTime;
-    tm *timeInfo;
-    time(&rawTime);
-    timeInfo = localtime(&rawTime);
-    char *temp = asctime(timeInfo);
-    strncpy(needUpdate, temp, 24);
+    static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4];
+    const char *m;
+    struct tm t;
+
+    bzero((char *) &t, sizeof(t));
+    if (sscanf(when, "%*s %3s %d %d:%d:%d %d", month, &t.tm_mday,
+		&t.tm_hour, &t.tm_min, &t.tm_sec, &t.tm_year) != 6
+	    || (m = strstr(months, month)) == NULL)
+	return 0;
+    t.tm_mon = (m - months) / 3;
+    t.tm_year -= 1900;
+    t.tm_isdst = -1;
+    return mktime(&t);
 }
 
-void 
-Directory::updateVisitedTime(char *targetPath, char *name)
+//----------------------------------------------------------------------
+// Directory::Accessed
+// 	The file "name" has been opened.  Update its access time, as
+//	"mode" says: always, only if the file has not been accessed since
+//	it was last modified (times are kept to the second) or for
+//	RelatimeInterval seconds, or never.  Return TRUE if the entry
+//	changed.
+//
+//	Writes stamp the modification time in the file header, which is
+//	passed in as "modified"; the entry's copy catches up here.
+//
+//	Only the table in memory changes; the caller decides when it is
+//	written back.
+//----------------------------------------------------------------------
+
+bool
+Directory::Accessed(char *name, AtimeMode mode, int modified)
 {
-    int i = FindIndex(targetPath, name);
+    int i = FindIndex(name);
+    time_t visited;
+    bool changed = FALSE;
+
+    if (i == -1)
+        return FALSE;
+    if (modified > ParseTime(table[i].lastModified)) {
+        FormatTime(table[i].lastModified, modified);
+        Touch(i, i);
+        changed = TRUE;
+    }
+    if (mode == AtimeNever)
+        return changed;
+    if (mode == AtimeRelative) {
+        visited = ParseTime(table[i].lastVisited);
+        if (visited >= ParseTime(table[i].lastModified)
+                && time(NULL) - visited < RelatimeInterval)
+            return changed;
+    }
     updateTime(table[i].lastVisited);
+    Touch(i, i);
+    return TRUE;
 }
 
 void 
 Directory::updateModifiedTime(int sector)
 {
-    int index;
     for (int i = 0; i < tableSize; i++)
     {
         if (table[i].inUse && table[i].sector == sector)
         {
-            index = i;
-            break;
+            updateTime(table[i].lastModified);
+            Touch(i, i);
+            return;
         }
     }
-    updateTime(table[index].lastModified);  
 }
 
 void 
-Directory::updateModified(char *targetPath, char *name)
+Directory::updateModified(char *name)
 {
-    int i = FindIndex(targetPath, name);
+    int i = FindIndex(name);
     updateTime(table[i].lastModified);
+    Touch(i, i);
 }
 
-bool 
-Directory::existDirectory(char *fullPath)
+void
+Directory::AddOpenThreads(char *name)
 {
-    if(!strcmp("/", fullPath))
-    {
-        return TRUE;
-        printf("path is / and already existed\n");
-    }
-
-    char *newPath = new char[100];
-    for(int i=0; i<tableSize; i++)
-    {
-        if(table[i].inUse && table[i].type == 'd')
-        {
-            
-            memset(newPath, 0, sizeof newPath);
-            strcat(newPath, table[i].path);
-            strcat(newPath, table[i].name);
-            strcat(newPath, "/");
-            printf("new path is %s now\n", newPath);
-            if(!strcmp(newPath, fullPath))
-            {
-                printf("new path is %s and fullPath is %s, they equal\n",newPath, fullPath);
-                delete newPath;
-                return TRUE;
-            }
-        }
-    }
-    printf("no such directory!\n");
-    delete newPath;
-    return FALSE;
-}
+    int i = FindIndex(name);
 
-
-void  
-Directory::AddOpenThreads(char *targetPath, char *name)
-{
-    for(int i=0; i<tableSize; i++)
+    if(i != -1)
     {
-        if(!strcmp(table[i].path, targetPath) && !strcmp(table[i].name, name))
-        {
-            ASSERT(table[i].inUse);
-            FileOpenThreads[i]++;
-            //printf("FileOpenThreads[%d] is %d\n", i, FileOpenThreads[i]);
-            ASSERT(FileOpenThreads[i] >= 0);
-            break;
-        }
+        table[i].openThreads++;
+        ASSERT(table[i].openThreads >= 0);
+        Touch(i, i);
     }
-    
 }
 
 void 
-Directory::SubFileThreads(char *targetPath, char *name)
+Directory::SubFileThreads(char *name)
 {
-    for(int i=0; i<tableSize; i++)
+    int i = FindIndex(name);
+
+    if(i != -1)
     {
-        if(!strcmp(table[i].path, targetPath) && !strcmp(table[i].name, name))
-        {
-            ASSERT(table[i].inUse);
-            FileOpenThreads[i]--;
-            //printf("FileOpenThreads[%d] is %d now\n", i, FileOpenThreads[i]);
-            ASSERT(FileOpenThreads[i] >= 0);
-            break;
-        }
+        table[i].openThreads--;
+        ASSERT(table[i].openThreads >= 0);
+        Touch(i, i);
     }
 }
 
 int 
-Directory::getFileThreads(char *targetPath, char *name)
+Directory::getFileThreads(char *name)
 {
-    for(int i=0; i<tableSize; i++)
-    {
-        if(!strcmp(table[i].path, targetPath) && !strcmp(table[i].name, name))
-        {
-            ASSERT(table[i].inUse);
-            ASSERT(FileOpenThreads[i] >= 0);
-            printf("in directory::getFileThreads, FileOpenThreads[%d] is %d\n", i, FileOpenThreads[i]);
-            return FileOpenThreads[i];
-        }
-    }
-    ASSERT(FALSE);
-}
+    int i = FindIndex(name);
 
+    ASSERT(i != -1);
+    ASSERT(table[i].openThreads >= 0);
+    return table[i].openThreads;
+}
 
 void 
 Directory::cleanThreadsNum()
 {
     for(int i=0; i<tableSize; i++)
-    {
-        FileOpenThreads[i] = 0;
-    }
+        table[i].openThreads = 0;
+    Touch(0, tableSize - 1);
 }
-
-
-
-
-
@@ -6,7 +6,18 @@
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
-//      We assume mutual exclusion is provided by the caller.
+//	Directories nest: an entry of type 'd' names another directory,
+//	stored in its own directory file.  A path such as "/a/b/" is
+//	resolved one component at a time by the file system (filesys.cc);
+//	a directory only knows the names directly inside it.
+//
+//	Entries are looked up by name through a hash index kept in memory
+//	alongside the table, so a lookup does not get slower as the
+//	directory grows.  The index is rebuilt whenever the table is read
+//	from disk, and is never stored there.
+//
+//      We assume mutual exclusion is provided by the caller (for a
+//      cached directory, its lock in the dentry cache; cf. dcache.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -20,9 +31,20 @@
 #include "openfile.h"
 
 #define FileNameMaxLen 		127	// for simplicity, we assume 
-#define NumDirEntries        10
+#define NumDirEntries        10		// initial size of a directory;
+					// Add makes room for more
+
+#define RelatimeInterval (24 * 60 * 60)	// seconds before a file accessed
+					// since it was modified has its
+					// access time updated again
+
+// When opening a file updates its access time (cf. Directory::Accessed):
+// every time, as UNIX did; only if it was last accessed before it was
+// last modified, or a day ago ("relatime"); or never ("noatime").  Writes
+// stamp the modification time in the file header; an entry's copy of it
+// catches up when the file is next opened.
 
-					// file names are <= 9 characters long
+enum AtimeMode { AtimeStrict, AtimeRelative, AtimeNever };
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -38,21 +60,19 @@ class DirectoryEntry {
 					//   FileHeader for this file 
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
 					// the trailing '\0'
-    //char *name; 
     char type;          //'f' denotes file, 'd' denotes directory
     char createTime[25];
     char lastVisited[25];
     char lastModified[25];
-    char path[100];
-    int threadNumber;
-
+    int openThreads;			// threads that have the file open
 };
 
 // The following class defines a UNIX-like "directory".  Each entry in
 // the directory describes a file, and where to find it on disk.
 //
 // The directory data structure can be stored in memory, or on disk.
-// When it is on disk, it is stored as a regular Nachos file.
+// When it is on disk, it is stored as a regular Nachos file, and the
+// number of entries is the length of that file.
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
@@ -65,53 +85,64 @@ class Directory {
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
-					// directory contents back to disk
+    bool WriteBack(OpenFile *file);	// Write modifications to
+					// directory contents back to disk;
+					// only the entries that changed
 
-    int Find(char *targetPath, char *name);		// Find the sector number of the 
+    int Find(char *name);		// Find the sector number of the
 					// FileHeader for file: "name"
+    bool IsDirectory(char *name);	// Is "name" a subdirectory?
 
-    bool Add(char *name, int newSector, char type, char *targetPath);  // Add a file name into the directory
+    bool Add(char *name, int newSector, char type);  // Add a file name into the directory
 
-    bool Remove(char *targetPath, char *name);		// Remove a file from the directory
+    bool Remove(char *name);		// Remove a file from the directory
 
-    void List();			// Print the names of all the files
+    void List(char *path);		// Print the names of all the files
 					//  in the directory
     void Print();			// Verbose print of the contents
 					//  of the directory -- all the file
 					//  names and their contents.
-    //char *getCurrentPath(){return currentPath;}
     void PrintTableEntry(){
         for(int i=0; i<tableSize; i++)
             printf("entry name is %s and sector is %d\n", table[i].name, table[i].sector);
 
     }
-    void addThread(char *targetPath, char *name);
-    void subThread(char *targetPath, char *name);
-    int getThread(char *targetPath, char *name);
     void updateTime(char needUpdate[]);
-    void updateVisitedTime(char *targetPath, char *name);
+    void updateVisitedTime(char *name);
     void updateModifiedTime(int sector);
-    void updateModified(char *targetPath, char *name);
-    bool existDirectory(char *fullPath);
+    void updateModified(char *name);
+    bool Accessed(char *name, AtimeMode mode, int modified);
+					// "name", whose data last changed at
+					// "modified", was opened; update its
+					// times if "mode" says so
     int getTableSize(){return tableSize;}
-    void  AddOpenThreads(char *targetPath, char *name);
-    void SubFileThreads(char *targetPath, char *name);
-    int getFileThreads(char *targetPath, char *name);
+    DirectoryEntry *getEntry(int i){return table[i].inUse ? &table[i] : NULL;}
+    bool IsEmpty();			// No entries in use?
+    void  AddOpenThreads(char *name);
+    void SubFileThreads(char *name);
+    int getFileThreads(char *name);
     void cleanThreadsNum();
 
-
-    //bool changeDirectory(char *newPath);
-
   private:
     int tableSize;			// Number of directory entries
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
-    //char *currentPath;
-    int *FileOpenThreads;
 
-    int FindIndex(char *targetPath, char *name);		// Find the index into the directory 
+    int numBuckets;			// Number of hash chains
+    int *bucket;			// First entry in each chain, or -1
+    int *nextInChain;			// Next entry in the same chain as
+					//  each entry, or -1
+    int firstDirty, lastDirty;		// Entries changed since the table
+					//  was last read or written
+
+    int FindIndex(char *name);		// Find the index into the directory
 					//  table corresponding to "name"
+    void Resize(int size);		// Make room for "size" entries
+    int Hash(char *name);		// Which chain an entry is on
+    void BuildIndex();			// Index every entry in use
+    void IndexEntry(int i);		// Add/remove table[i] to/from
+    void UnindexEntry(int i);		//  the hash index
+    void Touch(int first, int last);	// Entries "first" to "last" changed
 };
 
 #endif // DIRECTORY_H
@@ -0,0 +1,222 @@
+// diskarray.cc
+//	Routines to stripe or mirror requests over several disks.  See
+//	diskarray.h.
+//
+//	A request for the array becomes one request for one disk (a read,
+//	or any request to a striped array) or one for each disk (a write
+//	to a mirror).  These requests to the disks are made by the array,
+//	with a handler that completes the original request when the last
+//	of them is done.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "diskarray.h"
+#include "system.h"
+
+// What the array remembers about a request it has split up.
+
+class ArrayRequest {
+  public:
+    DiskArray *array;
+    DiskRequest *parent;		// the request made to the array
+    DiskRequest *children[MaxDisks];	// the requests made to the disks
+    int count;				// how many of them
+    int outstanding;			// how many are not yet done
+};
+
+//----------------------------------------------------------------------
+// DiskInterrupt, ArrayRequestDone
+// 	The disk interrupt handler, and the handler for requests to each
+//	disk.  C routines, because C++ can't handle pointers to member
+//	functions.
+//
+//	Each disk is created before its queue, so its interrupt handler
+//	is given where the queue will be.
+//----------------------------------------------------------------------
+
+static void
+DiskInterrupt(int arg)
+{
+    (*(DiskQueue **) arg)->RequestDone();
+}
+
+static void
+ArrayRequestDone(int arg)
+{
+    ArrayRequest *split = (ArrayRequest *) arg;
+
+    split->array->ChildDone(split);
+}
+
+//----------------------------------------------------------------------
+// DiskArray::DiskArray
+// 	Create the disks, each with its own latency model and queue.
+//
+//	"name" -- UNIX file name of the disk, or the prefix of the names
+//	"numDisks" -- how many disks
+//	"layout" -- stripe or mirror
+//	"policy" -- the order each disk serves waiting requests in
+//	"modelName" -- how long disk requests take (see NewLatencyModel)
+//----------------------------------------------------------------------
+
+DiskArray::DiskArray(char *name, int howMany, ArrayLayout theLayout,
+				DiskPolicy policy, char *modelName)
+{
+    ASSERT(howMany >= 1 && howMany <= MaxDisks);
+    numDisks = howMany;
+    layout = theLayout;
+    for (int i = 0; i < numDisks; i++) {
+	LatencyModel *model = NewLatencyModel(modelName);
+	char *diskName = name;
+	char buffer[100];
+
+	ASSERT(model != NULL);
+	if (numDisks > 1) {
+	    sprintf(buffer, "%s.%d", name, i);
+	    diskName = buffer;
+	}
+	disks[i] = new Disk(diskName, DiskInterrupt, (int) &queues[i], model);
+	queues[i] = new DiskQueue(disks[i], policy);
+    }
+    DEBUG('d', "Disk array of %d disks, %s\n", numDisks,
+			(layout == ArrayMirror) ? "mirrored" : "striped");
+}
+
+//----------------------------------------------------------------------
+// DiskArray::~DiskArray
+// 	De-allocate the disks and their queues.
+//----------------------------------------------------------------------
+
+DiskArray::~DiskArray()
+{
+    for (int i = 0; i < numDisks; i++) {
+	delete queues[i];
+	delete disks[i];
+    }
+}
+
+//----------------------------------------------------------------------
+// DiskArray::Map
+// 	Return which disk of a striped array holds "sector", and where
+//	on that disk it is.
+//----------------------------------------------------------------------
+
+void
+DiskArray::Map(int sector, int *disk, int *physical)
+{
+    int chunk = sector / StripeSectors;
+
+    *disk = chunk % numDisks;
+    *physical = (chunk / numDisks) * StripeSectors + sector % StripeSectors;
+}
+
+//----------------------------------------------------------------------
+// DiskArray::PickMirror
+// 	Return the mirror that can be expected to read "sector" soonest:
+//	the one with the fewest requests ahead of it, and of those, the
+//	one whose head is closest.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+int
+DiskArray::PickMirror(int sector)
+{
+    int best = 0, bestLength = 0, bestTime = 0;
+
+    for (int i = 0; i < numDisks; i++) {
+	int rotation;
+	int length = queues[i]->Length();
+	int time = disks[i]->TimeToSeek(sector, &rotation) + rotation;
+
+	if (i == 0 || length < bestLength
+			|| (length == bestLength && time < bestTime)) {
+	    best = i;
+	    bestLength = length;
+	    bestTime = time;
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// DiskArray::Submit
+// 	Queue "request" at the disk, or disks, that hold its sector, and
+//	return without waiting.  The request is completed when every disk
+//	it went to is done.
+//----------------------------------------------------------------------
+
+void
+DiskArray::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel;
+    ArrayRequest *split;
+    int disk, physical, count;
+
+    ASSERT(request->sector >= 0 && request->sector < NumSectors);
+    if (numDisks == 1) {
+	queues[0]->Submit(request);
+	return;
+    }
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    if (layout == ArrayStripe)
+	Map(request->sector, &disk, &physical);
+    else {
+	disk = request->writing ? 0 : PickMirror(request->sector);
+	physical = request->sector;
+    }
+    count = (layout == ArrayMirror && request->writing) ? numDisks : 1;
+
+    split = new ArrayRequest;
+    split->array = this;
+    split->parent = request;
+    split->count = split->outstanding = count;
+    for (int i = 0; i < count; i++)
+	split->children[i] = new DiskRequest(physical, request->data,
+			request->writing, ArrayRequestDone, (int) split);
+    for (int i = 0; i < count; i++)
+	queues[disk + i]->Submit(split->children[i]);	// a read may be
+							// done at once
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// DiskArray::ChildDone
+// 	A request to one of the disks, made for "split", is done.  If it
+//	was the last one, complete the array request.  Called with
+//	interrupts off, from DiskRequest::Complete, which no longer needs
+//	the request once the handler is called.
+//----------------------------------------------------------------------
+
+void
+DiskArray::ChildDone(ArrayRequest *split)
+{
+    if (--split->outstanding > 0)
+	return;
+    split->parent->Complete();
+    for (int i = 0; i < split->count; i++)
+	delete split->children[i];
+    delete split;
+}
+
+//----------------------------------------------------------------------
+// DiskArray::WriteImmediate
+// 	Write a sector right away, to every disk that holds it.  Only for
+//	use while Nachos is halting.
+//----------------------------------------------------------------------
+
+void
+DiskArray::WriteImmediate(int sector, char *data)
+{
+    int disk, physical;
+
+    if (layout == ArrayMirror) {
+	for (int i = 0; i < numDisks; i++)
+	    disks[i]->WriteImmediate(sector, data);
+	return;
+    }
+    Map(sector, &disk, &physical);
+    disks[disk]->WriteImmediate(physical, data);
+}
@@ -0,0 +1,72 @@
+// diskarray.h
+//	Data structures for a block device made of several simulated
+//	disks.
+//
+//	Each disk is its own UNIX file, with its own latency model (so
+//	its own head, or its own channels) and its own request queue.
+//	The array spreads the file system's sectors over them in one of
+//	two ways:
+//
+//	   stripe (RAID-0) -- consecutive chunks of StripeSectors sectors
+//			go to the disks in turn, so that requests for
+//			different chunks are served at the same time
+//	   mirror (RAID-1) -- every disk holds every sector; a write goes
+//			to all of them, and a read to whichever can serve
+//			it soonest, leaving the others free for other reads
+//
+//	The file system sees NumSectors sectors either way.  With a single
+//	disk, requests go straight to its queue.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DISKARRAY_H
+#define DISKARRAY_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "diskqueue.h"
+#include "stats.h"
+
+#define StripeSectors	8	// sectors per chunk when striping
+
+enum ArrayLayout { ArrayStripe, ArrayMirror };
+
+class ArrayRequest;
+
+// The following class defines the array.  Requests are submitted the
+// same way as to a DiskQueue.
+
+class DiskArray {
+  public:
+    DiskArray(char *name, int numDisks, ArrayLayout layout,
+			DiskPolicy policy, char *modelName);
+					// Create "numDisks" disks, named
+					// "name" if there is just one, and
+					// "name.0", "name.1", ... otherwise
+    ~DiskArray();
+
+    void Submit(DiskRequest *request);	// Queue a request for a sector of
+					// the array, and return without
+					// waiting for it
+    void WriteImmediate(int sector, char *data);
+					// Write a sector with no simulated
+					// delay, for use at shutdown only
+
+    void ChildDone(ArrayRequest *split);
+					// A request to one disk, made on
+					// behalf of an array request, is done
+
+  private:
+    int numDisks;
+    ArrayLayout layout;
+    Disk *disks[MaxDisks];		// the disks,
+    DiskQueue *queues[MaxDisks];	// and the requests waiting for each
+
+    void Map(int sector, int *disk, int *physical);
+					// Where a stripe sector lives
+    int PickMirror(int sector);		// Which mirror to read from
+};
+
+#endif // DISKARRAY_H
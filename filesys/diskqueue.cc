@@ -0,0 +1,295 @@
+// diskqueue.cc
+//	Routines to schedule requests for the disk.  See diskqueue.h.
+//
+//	The queue is changed both by threads submitting requests and by
+//	the disk interrupt handler, so it is protected by turning
+//	interrupts off.  The queue is short, so it is searched linearly.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "diskqueue.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// DiskRequest::DiskRequest
+// 	Set up a request to read or write "sector", from or to "data".
+//	If "handler" is not NULL, it is called with "handlerArg" when the
+//	request is done.
+//----------------------------------------------------------------------
+
+DiskRequest::DiskRequest(int theSector, char *theData, bool isWrite,
+				VoidFunctionPtr theHandler, int theArg)
+{
+    sector = theSector;
+    data = theData;
+    writing = isWrite;
+    handler = theHandler;
+    handlerArg = theArg;
+    queuedAt = 0;
+    next = NULL;
+    finished = FALSE;
+    done = new Semaphore("disk request", 0);
+}
+
+DiskRequest::~DiskRequest()
+{
+    delete done;
+}
+
+//----------------------------------------------------------------------
+// DiskRequest::Wait
+// 	Wait until the request is done.  Any number of threads can wait
+//	for the same request.
+//----------------------------------------------------------------------
+
+void
+DiskRequest::Wait()
+{
+    done->P();
+    done->V();				// let the next waiter through
+}
+
+//----------------------------------------------------------------------
+// DiskRequest::Complete
+// 	The request is done: wake up the threads waiting for it, and call
+//	the handler, if any.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+DiskRequest::Complete()
+{
+    ASSERT(!finished);
+    finished = TRUE;
+    done->V();
+    if (handler != NULL)
+	(*handler)(handlerArg);		// last, in case it deletes us
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::DiskQueue
+// 	Initialize an empty queue in front of "disk", scheduled by
+//	"policy".
+//----------------------------------------------------------------------
+
+DiskQueue::DiskQueue(Disk *theDisk, DiskPolicy thePolicy)
+{
+    disk = theDisk;
+    policy = thePolicy;
+    active = NULL;
+    numActive = 0;
+    pending = NULL;
+    sweepingUp = TRUE;
+    stats->diskPolicy = PolicyName(policy);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::PolicyName
+// 	Return the name of a scheduling policy, for printing.
+//----------------------------------------------------------------------
+
+char *
+DiskQueue::PolicyName(DiskPolicy policy)
+{
+    switch (policy) {
+      case DiskFIFO:	return "FIFO";
+      case DiskSSTF:	return "SSTF";
+      case DiskSCAN:	return "SCAN";
+      case DiskCLOOK:	return "C-LOOK";
+    }
+    return "?";
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Length
+// 	Return how many requests are waiting or in progress.
+//----------------------------------------------------------------------
+
+int
+DiskQueue::Length()
+{
+    int length = numActive;
+
+    for (DiskRequest *r = pending; r != NULL; r = r->next)
+	length++;
+    return length;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Submit
+// 	Add "request" to the end of the queue, and start it right away
+//	if the disk is idle.  Several requests can be waiting at once;
+//	each is completed when the disk has done it.
+//
+//	A read of a sector with a write queued or in progress is copied
+//	from the newest such write instead, and completed at once.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    DiskRequest *newest = NULL;
+    DiskRequest **tail = &pending;
+
+    if (!request->writing) {
+	for (DiskRequest *r = active; r != NULL; r = r->next)
+	    if (r->writing && r->sector == request->sector)
+		newest = r;
+	for (DiskRequest *r = pending; r != NULL; r = r->next)
+	    if (r->writing && r->sector == request->sector)
+		newest = r;
+	if (newest != NULL) {
+	    bcopy(newest->data, request->data, SectorSize);
+	    request->Complete();
+	    (void) interrupt->SetLevel(oldLevel);
+	    return;
+	}
+    }
+
+    request->queuedAt = stats->totalTicks;
+    request->next = NULL;
+    while (*tail != NULL)
+	tail = &(*tail)->next;
+    *tail = request;
+    StartNext();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::RequestDone
+// 	The disk has finished an active request, the one for the sector
+//	it reports.  Account for how long it took from submission, start
+//	another in its place, and complete this one.  Called with
+//	interrupts off.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::RequestDone()
+{
+    DiskRequest **link = &active;
+    DiskRequest *request;
+
+    while (*link != NULL && (*link)->sector != disk->DoneSector())
+	link = &(*link)->next;
+    request = *link;
+    ASSERT(request != NULL);
+    *link = request->next;
+    numActive--;
+
+    stats->numDiskRequests++;
+    stats->diskQueueTicks += stats->totalTicks - request->queuedAt;
+    StartNext();
+    request->Complete();
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::StartNext
+// 	While the disk can take another request and any is waiting, take
+//	the one the policy picks off the queue and hand it to the disk.
+//	Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::StartNext()
+{
+    DiskRequest *request;
+
+    while (numActive < disk->Parallelism() && (request = Pick()) != NULL) {
+	DiskRequest **link = &pending;
+
+	while (*link != request)
+	    link = &(*link)->next;
+	*link = request->next;
+	request->next = active;
+	active = request;
+	numActive++;
+
+	DEBUG('d', "Disk queue starts %s of sector %d\n",
+		request->writing ? "write" : "read", request->sector);
+	if (request->writing)
+	    disk->WriteRequest(request->sector, request->data);
+	else
+	    disk->ReadRequest(request->sector, request->data);
+    }
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Blocked
+// 	Return TRUE if a request for the same sector as "request" came
+//	before it, and is waiting or still in progress, so that "request"
+//	must not start yet.
+//----------------------------------------------------------------------
+
+bool
+DiskQueue::Blocked(DiskRequest *request)
+{
+    for (DiskRequest *r = active; r != NULL; r = r->next)
+	if (r->sector == request->sector)
+	    return TRUE;
+    for (DiskRequest *r = pending; r != request; r = r->next)
+	if (r->sector == request->sector)
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Pick
+// 	Return the waiting request to start next, according to the
+//	policy, or NULL if none can start.  Distances are measured in
+//	tracks from where the head is now, as in Disk::TimeToSeek; ties
+//	go to the request that came first.
+//----------------------------------------------------------------------
+
+DiskRequest *
+DiskQueue::Pick()
+{
+    int head = disk->CurrentTrack();
+    DiskRequest *best = NULL, *lowest = NULL;
+    int bestCost = 0;
+
+    if (policy == DiskFIFO) {
+	for (DiskRequest *r = pending; r != NULL; r = r->next)
+	    if (!Blocked(r))
+		return r;
+	return NULL;
+    }
+
+    for (int pass = 0; pass < 2 && best == NULL; pass++) {
+	for (DiskRequest *r = pending; r != NULL; r = r->next) {
+	    int track = r->sector / SectorsPerTrack;
+	    int cost, rotation;
+
+	    if (Blocked(r))
+		continue;
+	    switch (policy) {
+	      case DiskSSTF:		// soonest to reach, either way
+		cost = disk->TimeToSeek(r->sector, &rotation) + rotation;
+		break;
+	      case DiskSCAN:		// nearest in the sweep direction
+		if (sweepingUp ? track < head : track > head)
+		    continue;
+		cost = sweepingUp ? track - head : head - track;
+		break;
+	      default:			// C-LOOK: nearest at or above
+		if (lowest == NULL || track < lowest->sector / SectorsPerTrack)
+		    lowest = r;
+		if (track < head)
+		    continue;
+		cost = track - head;
+		break;
+	    }
+	    if (best == NULL || cost < bestCost) {
+		best = r;
+		bestCost = cost;
+	    }
+	}
+	if (best == NULL && policy == DiskSCAN)
+	    sweepingUp = !sweepingUp;	// nothing ahead; turn around
+	else if (best == NULL)
+	    best = lowest;		// C-LOOK: back to the lowest track
+    }
+    return best;
+}
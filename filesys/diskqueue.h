@@ -0,0 +1,100 @@
+// diskqueue.h
+//	Data structures for the queue of requests waiting for the disk.
+//
+//	The simulated disk can only work on a few requests at a time (a
+//	rotating disk, just one), but several threads may want it at once.
+//	Their requests wait here, and each time the disk finishes one, the
+//	scheduling policy picks which to start next:
+//
+//	   FIFO   -- in the order they arrived
+//	   SSTF   -- the one the head can get to soonest
+//	   SCAN   -- sweep the head across the disk and back, serving
+//		     requests on the way (the elevator algorithm)
+//	   C-LOOK -- sweep towards the end of the disk only, then jump
+//		     back to the lowest track waiting
+//
+//	Two requests for the same sector are never reordered.  A read of
+//	a sector that is waiting to be written (or being written) is
+//	served from the data being written, without going to the disk.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DISKQUEUE_H
+#define DISKQUEUE_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "synch.h"
+
+enum DiskPolicy { DiskFIFO, DiskSSTF, DiskSCAN, DiskCLOOK };
+
+// The following class defines one request for the disk.  It belongs to
+// whoever issued it, who must keep it (and "data") until it is done.
+//
+// Whoever issued a request can either wait for it, or ask for "handler"
+// to be called when it is done, and go on with something else meanwhile.
+// The handler is called with interrupts off, usually from the disk
+// interrupt handler, so it must not wait for anything.  It may delete
+// the request.
+
+class DiskRequest {
+  public:
+    DiskRequest(int sector, char *data, bool writing,
+			VoidFunctionPtr handler = NULL, int handlerArg = 0);
+					// Set up a request, to be queued
+    ~DiskRequest();
+
+    void Wait();			// Wait until the request is done
+    bool IsDone() { return finished; }	// Is it done yet?
+    void Complete();			// The request is done; wake up
+					// whoever is waiting for it
+
+    int sector;				// the sector to read or write
+    char *data;				// where the data comes from/goes
+    bool writing;			// write, rather than read?
+    VoidFunctionPtr handler;		// called when it is done, or NULL
+    int handlerArg;			// what to pass to "handler"
+    int queuedAt;			// when it was submitted, in ticks
+    DiskRequest *next;			// next request waiting
+
+  private:
+    bool finished;			// has it been done?
+    Semaphore *done;			// signalled when it is finished
+};
+
+// The following class defines the queue in front of the disk.
+
+class DiskQueue {
+  public:
+    DiskQueue(Disk *disk, DiskPolicy policy);
+    					// Queue requests for "disk"
+
+    void Submit(DiskRequest *request);	// Queue a request, starting it if
+					// the disk is idle, and return
+					// without waiting for it
+    void RequestDone();			// The disk finished an active
+					// request; called by the interrupt
+					// handler
+
+    int Length();			// How many requests are waiting or
+					// in progress
+
+    static char *PolicyName(DiskPolicy policy);
+
+  private:
+    Disk *disk;
+    DiskPolicy policy;
+    DiskRequest *active;		// being done by the disk
+    int numActive;			// how many of them
+    DiskRequest *pending;		// waiting, in the order they came
+    bool sweepingUp;			// SCAN: head moving to higher tracks?
+
+    DiskRequest *Pick();		// Choose the next request to start
+    void StartNext();			// Remove it and hand it to the disk
+    bool Blocked(DiskRequest *request);	// Is an earlier request waiting
+					// for the same sector?
+};
+
+#endif // DISKQUEUE_H
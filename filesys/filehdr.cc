@@ -3,16 +3,24 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a list of extents
+//	-- each entry in the list gives a run of consecutive disk sectors
+//	holding that portion of the file data.  The first few extents are
+//	in the header sector itself; the rest are in single, double and
+//	triple indirect blocks, as in UNIX (cf. DiskFileHeader).
+//
+//	New blocks are allocated as close as possible after the last
+//	block of the file, in runs as long as possible (cf.
+//	BitMap::FindRun), so that a file read from start to end moves
+//	the disk head forward a track at a time, and mostly reads out
+//	of the track buffer.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
 //
+//	A small file keeps its data in the header sector instead (cf.
+//	DiskFileHeader), and gets a data sector only once it outgrows it.
+//
 //	A file header can be initialized in two ways:
 //	   for a new file, by modifying the in-memory data structure
 //	     to point to the newly allocated data blocks
@@ -27,95 +35,392 @@
 #include "system.h"
 #include "filehdr.h"
 
+#include <time.h>
+
+//----------------------------------------------------------------------
+// LeavesFor
+// 	Return how many indirect blocks of extents a file with "numExtents"
+//	extents needs.
+//----------------------------------------------------------------------
+
+static int
+LeavesFor(int numExtents)
+{
+    if (numExtents <= NumDirect)
+	return 0;
+    return divRoundUp(numExtents - NumDirect, ExtentsPerBlock);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize an empty file header, with no blocks.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    onDisk.numBytes = 0;
+    onDisk.numSectors = 0;
+    onDisk.numExtents = 0;
+    onDisk.modified = 0;
+    extents = NULL;
+    firstBlock = NULL;
+    leafSector = NULL;
+    DropMap();
+    onDisk.indirect = onDisk.doubleIndirect = onDisk.tripleIndirect = -1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	De-allocate the in-memory extent list.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    DropMap();
+}
+
+//----------------------------------------------------------------------
+// FileHeader::DropMap
+// 	Forget the in-memory extent list; it is read in again from the
+//	header and its indirect blocks the next time it is needed.
+//----------------------------------------------------------------------
+
+void
+FileHeader::DropMap()
+{
+    delete [] extents;
+    delete [] firstBlock;
+    delete [] leafSector;
+    extents = NULL;
+    firstBlock = NULL;
+    leafSector = NULL;
+    mapSize = 0;
+    numLeaves = 0;
+    for (int j = 0; j < PointersPerBlock; j++)
+	midSector[j] = -1;
+    mapLoaded = FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MakeRoom
+// 	Make the in-memory extent list hold at least "n" extents, keeping
+//	the ones already there.  Like Directory::Resize, the list at least
+//	doubles, so that a file growing an extent at a time costs little.
+//----------------------------------------------------------------------
+
+void
+FileHeader::MakeRoom(int n)
+{
+    Extent *oldExtents = extents;
+    int *oldFirst = firstBlock;
+    int size = 2 * mapSize;
+
+    if (n <= mapSize)
+	return;
+    if (size < NumDirect)
+	size = NumDirect;
+    if (size < n)
+	size = n;
+    extents = new Extent[size];
+    firstBlock = new int[size];
+    for (int e = 0; e < mapSize; e++) {
+	extents[e] = oldExtents[e];
+	firstBlock[e] = oldFirst[e];
+    }
+    delete [] oldExtents;
+    delete [] oldFirst;
+    mapSize = size;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadMap
+// 	Read every extent of the file into memory, if that has not been
+//	done since the header was read in: the direct ones from the header,
+//	the rest from the indirect blocks, in file order.  Also note where
+//	each indirect block is, so that growing the file can rewrite them.
+//----------------------------------------------------------------------
+
+void
+FileHeader::LoadMap()
+{
+    int n = onDisk.numExtents;
+    int leaves = LeavesFor(n);
+    Extent leaf[ExtentsPerBlock];
+    int pointers[PointersPerBlock];
+    int mid = -1;			// which mid block is in "pointers"
+
+    if (mapLoaded)
+	return;
+    MakeRoom(n);
+    for (int e = 0; e < n && e < NumDirect; e++)
+	extents[e] = onDisk.direct[e];
+
+    if (leaves > 0)
+	leafSector = new int[MaxLeaves];
+    if (leaves > 1)
+	synchDisk->ReadSector(onDisk.doubleIndirect, (char *)pointers);
+    if (leaves > 1 + PointersPerBlock)
+	synchDisk->ReadSector(onDisk.tripleIndirect, (char *)midSector);
+    for (int l = 0; l < leaves; l++) {
+	int e = NumDirect + l * ExtentsPerBlock;
+
+	if (l == 0)
+	    leafSector[l] = onDisk.indirect;
+	else if (l <= PointersPerBlock)
+	    leafSector[l] = pointers[l - 1];
+	else {
+	    int m = l - 1 - PointersPerBlock;
+
+	    if (m / PointersPerBlock != mid) {
+		mid = m / PointersPerBlock;
+		synchDisk->ReadSector(midSector[mid], (char *)pointers);
+	    }
+	    leafSector[l] = pointers[m % PointersPerBlock];
+	}
+	synchDisk->ReadSector(leafSector[l], (char *)leaf);
+	for (int i = 0; i < ExtentsPerBlock && e + i < n; i++)
+	    extents[e + i] = leaf[i];
+    }
+    numLeaves = leaves;
+
+    for (int e = 0; e < n; e++)
+	firstBlock[e] = (e == 0) ? 0 : firstBlock[e - 1] + extents[e - 1].length;
+    mapLoaded = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::StoreMap
+// 	The extents from "fromExtent" on have changed (the last old one
+//	grew, or new ones were added).  Copy the direct ones into the
+//	header, and write the others out to their indirect blocks,
+//	allocating any indirect and pointer blocks the file now needs.
+//
+//	Return FALSE, having allocated nothing, if there is no room for
+//	the new indirect blocks.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::StoreMap(BitMap *freeMap, int fromExtent)
+{
+    int n = onDisk.numExtents;
+    int leaves = LeavesFor(n);
+    int oldLeaves = numLeaves;
+    int oldMids = 0, mids = 0;
+    int needed = leaves - oldLeaves;
+    int near = 0, length;
+    Extent leaf[ExtentsPerBlock];
+    int pointers[PointersPerBlock];
+
+    ASSERT(leaves <= MaxLeaves);
+    if (oldLeaves > 1 + PointersPerBlock)
+	oldMids = divRoundUp(oldLeaves - 1 - PointersPerBlock, PointersPerBlock);
+    if (leaves > 1 + PointersPerBlock)
+	mids = divRoundUp(leaves - 1 - PointersPerBlock, PointersPerBlock);
+    needed += mids - oldMids;
+    if (leaves > 1 && oldLeaves <= 1)
+	needed++;			// the double indirect block
+    if (mids > 0 && oldMids == 0)
+	needed++;			// the triple indirect block
+    if (needed > freeMap->NumClear())
+	return FALSE;
+
+    // allocate the new blocks, near the end of the data
+    if (n > 0)
+	near = extents[n - 1].start + extents[n - 1].length;
+    if (leaves > 0 && leafSector == NULL)
+	leafSector = new int[MaxLeaves];
+    for (int l = oldLeaves; l < leaves; l++) {
+	leafSector[l] = near = freeMap->FindRun(near, 1, &length);
+	if (l == 0)
+	    onDisk.indirect = leafSector[l];
+    }
+    if (leaves > 1 && oldLeaves <= 1)
+	onDisk.doubleIndirect = near = freeMap->FindRun(near, 1, &length);
+    if (mids > 0 && oldMids == 0)
+	onDisk.tripleIndirect = near = freeMap->FindRun(near, 1, &length);
+    for (int j = oldMids; j < mids; j++)
+	midSector[j] = near = freeMap->FindRun(near, 1, &length);
+
+    // the direct extents
+    for (int e = 0; e < n && e < NumDirect; e++)
+	onDisk.direct[e] = extents[e];
+
+    // the indirect blocks holding changed extents
+    for (int l = LeavesFor(fromExtent + 1) - 1; l < leaves; l++) {
+	int e = NumDirect + l * ExtentsPerBlock;
+
+	if (l < 0)
+	    continue;
+	bzero((char *)leaf, sizeof(leaf));
+	for (int i = 0; i < ExtentsPerBlock && e + i < n; i++)
+	    leaf[i] = extents[e + i];
+	synchDisk->WriteSector(leafSector[l], (char *)leaf);
+    }
+
+    // the pointer blocks with new entries
+    if (leaves > 1 && oldLeaves <= PointersPerBlock) {
+	for (int i = 0; i < PointersPerBlock; i++)
+	    pointers[i] = (1 + i < leaves) ? leafSector[1 + i] : -1;
+	synchDisk->WriteSector(onDisk.doubleIndirect, (char *)pointers);
+    }
+    if (mids > oldMids)
+	synchDisk->WriteSector(onDisk.tripleIndirect, (char *)midSector);
+    for (int j = 0; j < mids; j++) {
+	int first = 1 + PointersPerBlock + j * PointersPerBlock;
+
+	if (first + PointersPerBlock <= oldLeaves)
+	    continue;			// no new leaves under this one
+	for (int i = 0; i < PointersPerBlock; i++)
+	    pointers[i] = (first + i < leaves) ? leafSector[first + i] : -1;
+	synchDisk->WriteSector(midSector[j], (char *)pointers);
+    }
+
+    numLeaves = leaves;
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
 //	Allocate data blocks for the file out of the map of free disk blocks.
 //	Return FALSE if there are not enough free blocks to accomodate
-//	the new file.
+//	the new file.  A file of at most InlineSize bytes gets no blocks;
+//	it starts out inline, full of zeroes.
 //
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
+//	"thisSector" is where the header goes; the data goes right after it
 //----------------------------------------------------------------------
 
 bool
 FileHeader::Allocate(BitMap *freeMap, int fileSize, int thisSector)
-{ 
-    //hdrSector = thisSector;
-    numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
-	   return FALSE;		// not enough space
-    if(numSectors > 29+32) // exceed the max file limitation
-        return FALSE;
-    if(numSectors <= 29)
-    {
-        for (int i = 0; i < numSectors; i++)
-            dataSectors[i] = freeMap->Find();
-        dataSectors[29] = -1;
-        //printf("numSectors is small and dataSectors[29] is set to %d, hdrSector is %d\n", 
-          //  dataSectors[29], hdrSector);
-    }
-    else
-    {
-        for (int i = 0; i < 30; i++)
-            dataSectors[i] = freeMap->Find();
-        int secondSector = dataSectors[29];
-        int secondNeedSec = numSectors - 29;
-        int *secondIndex = new int[secondNeedSec];
-        for(int i=0; i<secondNeedSec; i++)
-        {
-            secondIndex[i] = freeMap->Find();
-        }
-        synchDisk->WriteSector(secondSector, (char *)secondIndex); 
+{
+    DropMap();
+    onDisk.numBytes = fileSize;
+    onDisk.numSectors = 0;
+    onDisk.numExtents = 0;
+    onDisk.indirect = onDisk.doubleIndirect = onDisk.tripleIndirect = -1;
+    onDisk.modified = (int) time(NULL);
+    mapLoaded = TRUE;			// nothing to read in
+    if (fileSize <= InlineSize) {	// small enough to keep in here
+	onDisk.numSectors = InlineFile;
+	bzero(onDisk.data, InlineSize);
+	return TRUE;
     }
+    return AddSectors(freeMap, divRoundUp(fileSize, SectorSize), thisSector + 1);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddSectors
+// 	Allocate "count" more data blocks at the end of the file, looking
+//	for free sectors from "near" onwards.  A run that starts right after
+//	the last extent just makes that extent longer.
+//
+//	Return FALSE, with the header and "freeMap" as they were, if there
+//	is not enough free space, or the free space is so fragmented that
+//	the file would need more than MaxExtents runs.
+//----------------------------------------------------------------------
 
-    
+bool
+FileHeader::AddSectors(BitMap *freeMap, int count, int near)
+{
+    int oldSectors, oldExtents, oldLength;
+    int start, length;
+
+    LoadMap();
+    oldSectors = onDisk.numSectors;
+    oldExtents = onDisk.numExtents;
+    oldLength = (oldExtents > 0) ? extents[oldExtents - 1].length : 0;
+    if (freeMap->NumClear() < count)
+	return FALSE;			// not enough space
+    while (count > 0) {
+	int n = onDisk.numExtents;
+
+	start = freeMap->FindRun(near, count, &length);
+	ASSERT(start != -1);
+	if (n > 0 && start == extents[n - 1].start + extents[n - 1].length)
+	    extents[n - 1].length += length;
+	else if (n < MaxExtents) {
+	    MakeRoom(n + 1);
+	    extents[n].start = start;
+	    extents[n].length = length;
+	    firstBlock[n] = onDisk.numSectors;
+	    onDisk.numExtents++;
+	} else {			// too fragmented; undo it all
+	    for (int i = 0; i < length; i++)
+		freeMap->Clear(start + i);
+	    UndoAdd(freeMap, oldSectors, oldExtents, oldLength);
+	    return FALSE;
+	}
+	onDisk.numSectors += length;
+	count -= length;
+	near = start + length;
+    }
+    if (!StoreMap(freeMap, (oldExtents > 0) ? oldExtents - 1 : 0)) {
+	UndoAdd(freeMap, oldSectors, oldExtents, oldLength);
+	return FALSE;
+    }
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::UndoAdd
+// 	Give back the data blocks added to the file since it had
+//	"oldSectors" blocks in "oldExtents" extents, the last of them
+//	"oldLength" long.
+//----------------------------------------------------------------------
+
+void
+FileHeader::UndoAdd(BitMap *freeMap, int oldSectors, int oldExtents,
+			int oldLength)
+{
+    for (int e = oldExtents; e < onDisk.numExtents; e++)
+	for (int i = 0; i < extents[e].length; i++)
+	    freeMap->Clear(extents[e].start + i);
+    if (oldExtents > 0) {
+	Extent *last = &extents[oldExtents - 1];
+
+	for (int i = oldLength; i < last->length; i++)
+	    freeMap->Clear(last->start + i);
+	last->length = oldLength;
+    }
+    onDisk.numExtents = oldExtents;
+    onDisk.numSectors = oldSectors;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and for the indirect blocks describing them.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
 
-void 
+void
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    if(dataSectors[29] == -1)       //2-level index not used
-    {
-       for (int i = 0; i < numSectors; i++) 
-       {
-            ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-            freeMap->Clear((int) dataSectors[i]);
-        } 
-    }
-    else                                            //2-level index used
-    {
-        int *secondIndex;
-        char *temp = new char[SectorSize];
-        synchDisk->ReadSector(dataSectors[29], temp);
-        secondIndex = (int *)temp;
-        for(int i=0; i<numSectors-29; i++)          //clear 2-level index first
-        {
-            ASSERT(freeMap->Test((int) secondIndex[i]));
-            freeMap->Clear((int) secondIndex[i]);
-        }
-        for(int i=0; i<30; i++)                     //then clear 1-level index
-        {
-            ASSERT(freeMap->Test((int) dataSectors[i]));
-            freeMap->Clear((int) dataSectors[i]);
-        }
-
+    LoadMap();
+    for (int e = 0; e < onDisk.numExtents; e++)
+	for (int i = 0; i < extents[e].length; i++) {
+	    ASSERT(freeMap->Test(extents[e].start + i));  // ought to be marked!
+	    freeMap->Clear(extents[e].start + i);
+	}
+    for (int l = 0; l < numLeaves; l++)
+	freeMap->Clear(leafSector[l]);
+    if (onDisk.doubleIndirect != -1)
+	freeMap->Clear(onDisk.doubleIndirect);
+    if (onDisk.tripleIndirect != -1) {
+	for (int j = 0; j < PointersPerBlock; j++)
+	    if (midSector[j] != -1)
+		freeMap->Clear(midSector[j]);
+	freeMap->Clear(onDisk.tripleIndirect);
     }
-    
 }
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk. 
+// 	Fetch contents of file header from disk.  The indirect blocks
+//	are read later, when the extents are first needed.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -123,12 +428,18 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    char buf[SectorSize];
+
+    ASSERT(sizeof(DiskFileHeader) <= SectorSize);
+    synchDisk->ReadSector(sector, buf);
+    bcopy(buf, (char *)&onDisk, sizeof(DiskFileHeader));
+    DropMap();
 }
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk. 
+// 	Write the modified contents of the file header back to disk.
+//	The indirect blocks are written as they change (cf. StoreMap).
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -136,7 +447,11 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this); 
+    char buf[SectorSize];
+
+    bzero(buf, SectorSize);
+    bcopy((char *)&onDisk, buf, sizeof(DiskFileHeader));
+    synchDisk->WriteSector(sector, buf);
 }
 
 //----------------------------------------------------------------------
@@ -146,38 +461,59 @@ FileHeader::WriteBack(int sector)
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	The extent holding the byte is found by binary search on the
+//	first block of each extent.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
 int
 FileHeader::ByteToSector(int offset)
 {
-    int firstSector = offset / SectorSize;
-    if(firstSector < 29)                //2-level index not used
-        return(dataSectors[offset / SectorSize]);
-    else
-    {
-        ASSERT(dataSectors[29] != -1);
-        int *secondIndex;
-        char *temp = new char[SectorSize];
-        synchDisk->ReadSector(dataSectors[29], temp);
-        secondIndex = (int *)temp;
-        //printf("in 2-level index offset %d is in phy sector number %d\n", offset, secondIndex[firstSector - 29]);
-        return(secondIndex[firstSector - 29]);
-    }
+    int block = offset / SectorSize;
+    int lo = 0, hi = onDisk.numExtents - 1;
+
+    LoadMap();
+    ASSERT(block >= 0 && block < onDisk.numSectors);	// within the file
+    while (lo < hi) {			// last extent starting at or before
+	int mid = (lo + hi + 1) / 2;	//  "block"
 
-    //return(dataSectors[offset / SectorSize]);
+	if (firstBlock[mid] <= block)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    return extents[lo].start + block - firstBlock[lo];
 }
 
 //----------------------------------------------------------------------
 // FileHeader::FileLength
-// 	Return the number of bytes in the file.
+// 	Return the number of bytes in the file.  The length is kept in 64
+//	bits on disk, but a Nachos file cannot outgrow the disk, so it
+//	always fits in an int.
 //----------------------------------------------------------------------
 
 int
 FileHeader::FileLength()
 {
-    return numBytes;
+    return (int) onDisk.numBytes;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Touch
+// 	Record that the file's data changed at "when".  Times are kept to
+//	the second, so a run of writes within one second changes the
+//	header only once.  Return TRUE if it changed, and so must be
+//	written back.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Touch(int when)
+{
+    if (onDisk.modified == when)
+	return FALSE;
+    onDisk.modified = when;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -190,110 +526,118 @@ void
 FileHeader::Print()
 {
     int i, j, k;
+    int numBytes = FileLength();
     char *data = new char[SectorSize];
 
+    if (IsInline()) {
+	printf("FileHeader contents.  File size: %d.  Inline:\n", numBytes);
+	for (j = 0; j < numBytes; j++)
+	    if ('\040' <= onDisk.data[j] && onDisk.data[j] <= '\176')
+		printf("%c", onDisk.data[j]);
+	    else
+		printf("\\%x", (unsigned char)onDisk.data[j]);
+	printf("\n");
+	delete [] data;
+	return;
+    }
+    LoadMap();
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-    for (i = 0; i < numSectors; i++)
-	   printf("%d ", dataSectors[i]);
+    for (i = 0; i < onDisk.numExtents; i++)
+	   printf("%d-%d ", extents[i].start,
+				extents[i].start + extents[i].length - 1);
     printf("\nFile contents:\n");
-    for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+    for (i = k = 0; i < onDisk.numSectors; i++) {
+	synchDisk->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
             else
 		printf("\\%x", (unsigned char)data[j]);
 	}
-        printf("\n"); 
+        printf("\n");
     }
     delete [] data;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::EnlargeFile
-//  Enlarge the file with bytesNeeded more bytes.
+//  Enlarge the file with bytesNeeded more bytes, past the end of its
+//  last block.  The new blocks are looked for right after the last one.
+//  Return FALSE, leaving the file as it was, if there is no room.
 //----------------------------------------------------------------------
 
-bool 
+bool
 FileHeader::EnlargeFile(BitMap *freeMap, int bytesNeeded)
 {
-    ASSERT(bytesNeeded > 0);
     int newSectors = divRoundUp(bytesNeeded, SectorSize);
-    printf("in FileHeader::EnlargeFile, newSectors is %d and numSectors is %d\n",
-    newSectors, numSectors);
-   
-    if(freeMap->NumClear() < newSectors)
-        return FALSE;
-    if(newSectors + numSectors >29+32)
+    int near = 0;
+    int n;
+
+    ASSERT(bytesNeeded > 0 && !IsInline());
+    DEBUG('f', "Enlarging file by %d sectors, from %d\n", newSectors,
+		onDisk.numSectors);
+    LoadMap();
+    n = onDisk.numExtents;
+    if (n > 0)
+        near = extents[n - 1].start + extents[n - 1].length;
+    if (!AddSectors(freeMap, newSectors, near))
         return FALSE;
-    if(newSectors + numSectors > 29)            //need to allocate new space in 2-level index
-    {
-        if(numSectors >29)                  //already uses a 2-level index
-        {
-            ASSERT(dataSectors[29] != -1);
-            int *secondIndex;
-            char *temp = new char[SectorSize];
-            synchDisk->ReadSector(dataSectors[29], temp);
-            secondIndex = (int *)temp;
-            for(int i=numSectors-29; i<newSectors+numSectors-29; i++)          //clear 2-level index first
-            {
-                secondIndex[i] = freeMap->Find();
-                printf("secondIndex[%d] is %d\n", i, secondIndex[i]);
-            }
-            synchDisk->WriteSector(dataSectors[29], (char *)secondIndex); 
-            numSectors += newSectors;
-            int prevSecNum = divRoundUp(numBytes, SectorSize);
-            //numBytes += bytesNeeded;
-            numBytes = prevSecNum * SectorSize + bytesNeeded;
-            printf("in situation 1 and now numSectors is %d, newSectors is %d, numBytes is %d\n", 
-                numSectors, newSectors, numBytes);
-        }
-        else
-        {
-            ASSERT(dataSectors[29] == -1);
-            for(int i=numSectors; i<30; i++)
-            {
-                dataSectors[i] = freeMap->Find();
-            }
-            int secondSector = dataSectors[29];
-            printf("in situation 2 new secondSector found is sector %d\n",secondSector);
-            int secondNeedSec = numSectors + newSectors - 29;
-            int *secondIndex = new int[secondNeedSec];
-            for(int i=0; i<secondNeedSec; i++)
-            {
-                secondIndex[i] = freeMap->Find();
-                printf("secondIndex[%d] is %d\n", i, secondIndex[i]);
-            }
-            synchDisk->WriteSector(secondSector, (char *)secondIndex); 
-            numSectors += newSectors;
-            int prevSecNum = divRoundUp(numBytes, SectorSize);
-            numBytes = prevSecNum * SectorSize + bytesNeeded;
-
-            printf("in situation 2 and now numSectors is %d, newSectors is %d, numBytes is %d\n", 
-                numSectors, newSectors, numBytes);
-
-
-        }
-        return TRUE;
-    }
-    else                                    //no need to use 2-level index
-    {
-        ASSERT(dataSectors[29] == -1);
-        for(int i=numSectors; i<numSectors+newSectors; i++)
-        {
-            dataSectors[i] = freeMap->Find();
-            printf("in situation 3 new sector found is %d\n", dataSectors[i]);
-        }
-        numSectors += newSectors;
-        int prevSecNum = divRoundUp(numBytes, SectorSize);
-        numBytes = prevSecNum * SectorSize + bytesNeeded;
-        //numBytes += bytesNeeded;
-        printf("in situation 3 and now numSectors is %d, newSectors is %d, numBytes is %d\n", 
-            numSectors, newSectors, numBytes);
-
-        return TRUE;
-    }
-    ASSERT(FALSE);
+    onDisk.numBytes = (long long) onDisk.numSectors * SectorSize
+			- newSectors * SectorSize + bytesNeeded;
+    return TRUE;
+}
 
+//----------------------------------------------------------------------
+// FileHeader::ReadInline/WriteInline
+// 	Copy "numBytes" bytes at "position" out of, or into, the data of
+//	an inline file.  A read must be within the file; a write may go
+//	past its end, but not past InlineSize, and makes it longer.
+//----------------------------------------------------------------------
 
-}
\ No newline at end of file
+void
+FileHeader::ReadInline(char *into, int numBytes, int position)
+{
+    ASSERT(IsInline() && position >= 0 && position + numBytes <= FileLength());
+    bcopy(&onDisk.data[position], into, numBytes);
+}
+
+void
+FileHeader::WriteInline(char *from, int numBytes, int position)
+{
+    ASSERT(IsInline() && position >= 0 && position + numBytes <= InlineSize);
+    bcopy(from, &onDisk.data[position], numBytes);
+    if (position + numBytes > FileLength())
+	onDisk.numBytes = position + numBytes;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Uninline
+// 	An inline file is about to outgrow its header.  Give it a data
+//	sector, looking for one from "near" on, and move its bytes there;
+//	from then on it is an ordinary file, and grows like one.
+//
+//	Return FALSE, leaving the file inline, if the disk is full.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Uninline(BitMap *freeMap, int near)
+{
+    char buf[SectorSize];
+    int length = FileLength();
+
+    ASSERT(IsInline());
+    bzero(buf, SectorSize);
+    bcopy(onDisk.data, buf, length);
+    DropMap();
+    mapLoaded = TRUE;			// no extents yet
+    onDisk.numSectors = 0;
+    if (length > 0 && !AddSectors(freeMap, 1, near)) {
+	onDisk.numSectors = InlineFile;
+	bcopy(buf, onDisk.data, InlineSize);
+	return FALSE;
+    }
+    DEBUG('f', "Moving a file of %d bytes out of its header\n", length);
+    if (length > 0)
+	synchDisk->WriteSector(ByteToSector(0), buf);
+    return TRUE;
+}
@@ -17,28 +17,86 @@
 #include "disk.h"
 #include "bitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
-//the max sector number a file can contain besides hdr
+// The following class defines one extent -- a run of consecutive disk
+// sectors holding consecutive blocks of a file.
 
+class Extent {
+  public:
+    int start;			// first sector of the run
+    int length;			// number of sectors in the run
+};
+
+#define NumDirect 	((int) ((SectorSize - sizeof(long long) - 6 * sizeof(int)) \
+				/ sizeof(Extent)))
+				// extents kept in the header itself
+#define ExtentsPerBlock ((int) (SectorSize / sizeof(Extent)))
+				// extents in one indirect block
+#define PointersPerBlock ((int) (SectorSize / sizeof(int)))
+				// sector numbers in one pointer block
+#define MaxLeaves 	(1 + PointersPerBlock + PointersPerBlock * PointersPerBlock)
+				// indirect blocks of extents: one single,
+				// the double's, and the triple's
+#define MaxExtents 	(NumDirect + MaxLeaves * ExtentsPerBlock)
+#define InlineSize 	((int) (NumDirect * sizeof(Extent)))
+				// bytes of data a file can keep in its
+				// header, in place of the direct extents
+#define InlineFile 	-1	// "numSectors" of a file kept that way
+
+// The following class defines what a file header holds on disk.
+//
+// The first NumDirect extents of the file are in the header.  The next
+// ExtentsPerBlock are in the block at "indirect"; after that come the
+// blocks listed in the pointer block at "doubleIndirect", then those
+// listed in the pointer blocks listed in the block at "tripleIndirect".
+// An unused pointer is -1.
+//
+// A file of at most InlineSize bytes has no data sectors at all: its
+// bytes are kept in the header, where the direct extents would be, so
+// that reading it costs one sector, the one the header is in.  Such a
+// file has InlineFile for "numSectors", no extents, and no indirect
+// blocks.  It is moved to a data sector when it grows past InlineSize.
+
+class DiskFileHeader {
+  public:
+    long long numBytes;			// Number of bytes in the file
+    int numSectors;			// Number of data sectors in the file,
+					// or InlineFile
+    int numExtents;			// Number of extents in use
+    union {
+	Extent direct[NumDirect];	// The first extents of the file,
+	char data[InlineSize];		// or the whole file, if inline
+    };
+    int indirect;			// Single indirect block of extents
+    int doubleIndirect;			// Block of single indirect blocks
+    int tripleIndirect;			// Block of double indirect blocks
+    int modified;			// When the data last changed, in
+					// seconds since the epoch
+};
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a list of extents: the first
+// extent holds the first blocks of the file, the next one the blocks
+// after those, and so on.  Allocation tries hard to keep a file in as
+// few extents as possible, so that reading it sequentially seldom has
+// to seek (cf. HddModel::Latency).
 //
 // The file header data structure can be stored in memory or on disk.
-// When it is on disk, it is stored in a single sector -- this means
-// that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// When it is on disk, it is stored in a single sector (plus whatever
+// indirect blocks the file needs).  In memory, the whole extent list
+// is kept in one array, read in from the indirect blocks the first time
+// it is needed, with the first file block of each extent alongside; a
+// byte offset is then found with a binary search, and no disk reads.
 //
-// There is no constructor; rather the file header can be initialized
+// The constructor makes an empty header; it can then be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
 
 class FileHeader {
   public:
+    FileHeader();
+    ~FileHeader();
+
     bool Allocate(BitMap *bitMap, int fileSize, int thisSector);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
@@ -49,30 +107,66 @@ class FileHeader {
     void WriteBack(int sectorNumber); 	// Write modifications to file header
 					//  back to disk
 
+    void LoadMap();			// Read in the extent map, if need
+					// be; done before a header is shared
     int ByteToSector(int offset);	// Convert a byte offset into the file
 					// to the disk sector containing
 					// the byte
 
     int FileLength();			// Return the length of the file 
 					// in bytes
-    int ChangeFileLength(int newLength){numBytes = newLength;}
+    void ChangeFileLength(int newLength){onDisk.numBytes = newLength;}
+    int ModifiedTime() { return onDisk.modified; }
+    bool Touch(int when);		// Note that the data changed at
+					// "when"; TRUE if the header did
 
     bool EnlargeFile(BitMap *freeMap, int bytesNeeded);
 
+    bool IsInline() { return onDisk.numSectors == InlineFile; }
+					// Is the data in the header?
+    void ReadInline(char *into, int numBytes, int position);
+    void WriteInline(char *from, int numBytes, int position);
+					// Transfer bytes of an inline file;
+					// a write may make it longer, up to
+					// InlineSize bytes
+    bool Uninline(BitMap *freeMap, int near);
+					// Move the data of an inline file
+					// to a data sector, near "near"
+
     void Print();			// Print the contents of the file.
-    int getNumBytes(){return numBytes;}
-    //int getSector(){return hdrSector;}
+    int getNumBytes(){return FileLength();}
     void PrintSectors(){
-        for(int i=0; i<30; i++)
-            printf("%d\n", dataSectors[i]);
+        LoadMap();
+        for(int i=0; i<onDisk.numExtents; i++)
+            printf("%d-%d\n", extents[i].start,
+				extents[i].start + extents[i].length - 1);
     }
 
   private:
-    //int hdrSector;
-    int numBytes;			// Number of bytes in the file
-    int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    DiskFileHeader onDisk;		// What is stored on disk
+
+    // In memory only:
+    bool mapLoaded;			// Are the arrays below filled in?
+    Extent *extents;			// Every extent, in file order
+    int *firstBlock;			// First file block of each extent
+    int mapSize;			// Room in "extents" and "firstBlock"
+    int *leafSector;			// Sector of each indirect block of
+					// extents, in file order
+    int numLeaves;			// Entries in "leafSector" in use
+    int midSector[PointersPerBlock];	// Pointer blocks under the triple
+					// indirect block
+
+    void DropMap();			// Forget them
+    void MakeRoom(int n);		// Make "extents" hold "n" extents
+    bool StoreMap(BitMap *freeMap, int fromExtent);
+					// Write the extents from "fromExtent"
+					// on into indirect blocks
+    bool AddSectors(BitMap *freeMap, int count, int near);
+					// Allocate "count" more blocks,
+					// starting the search at "near"
+    void UndoAdd(BitMap *freeMap, int oldSectors, int oldExtents,
+					int oldLastLength);
+					// Give back blocks added since
 };
 
 #endif // FILEHDR_H
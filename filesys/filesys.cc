@@ -11,33 +11,52 @@
 //
 // 	The file system consists of several data structures:
 //	   A bitmap of free disk sectors (cf. bitmap.h)
-//	   A directory of file names and file headers
+//	   A tree of directories of file names and file headers, starting
+//	     from the root directory
 //
-//      Both the bitmap and the directory are represented as normal
-//	files.  Their file headers are located in specific sectors
-//	(sector 0 and sector 1), so that the file system can find them 
-//	on bootup.
+//      The bitmap and every directory are represented as normal
+//	files.  The file headers of the bitmap and the root directory are
+//	located in specific sectors (sector 0 and sector 1), so that the
+//	file system can find them on bootup.
 //
-//	The file system assumes that the bitmap and directory files are
-//	kept "open" continuously while Nachos is running.
+//	The file system assumes that the bitmap and root directory files
+//	are kept "open" continuously while Nachos is running.  Paths are
+//	resolved one directory at a time, through the dentry cache
+//	(cf. dcache.h), which keeps recently used directories in memory.
 //
-//	For those operations (such as Create, Remove) that modify the
-//	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	For those operations (such as Create, Remove) that modify a
+//	directory, if the operation succeeds, the changes are written
+//	immediately back to disk.  Open and Close only change access
+//	times and open counts; those stay in the cached directory, which
+//	is written back later, together with other such changes (cf.
+//	dcache.h).  The bitmap is different: it is read in
+//	once, when Nachos starts, and from then on the copy in memory is
+//	the one that counts.  Every allocation and de-allocation, including
+//	a file growing in OpenFile::WriteAt, is made there, under a lock;
+//	the words that changed are written back by Sync, which is done
+//	by every operation that allocates or frees, and when Nachos halts.
+//	If an operation fails, the blocks it allocated are given back; a
+//	change to the in-memory directory is undone.
+//
+//	Each operation that changes metadata is a journal transaction
+//	(cf. journal.h): its header, directory and free map sectors reach
+//	the disk together or not at all, so a crash in the middle of it
+//	no longer corrupts the disk.  The journal occupies a fixed run of
+//	sectors after the two well-known headers.
+//
+//	Threads share the file system under a fixed lock order: a journal
+//	transaction is begun first, then a directory's lock (cf. dcache.h)
+//	is taken, then a file's inode lock (cf. inode.h), and the free
+//	map's lock last.  A lock is never waited for while a later one in
+//	this order is held.  Of two directory locks, a parent's is taken
+//	before its child's, and never waited for while the child's is held.
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
 //	   files have a fixed size, set when the file is created
 //	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   file data is not journaled; after a crash, a file may hold
+//	    blocks that were never written
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -48,8 +67,10 @@
 #include "disk.h"
 #include "bitmap.h"
 #include "directory.h"
+#include "dcache.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "inode.h"
 #include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
@@ -59,9 +80,8 @@
 #define DirectorySector 	1
 #define CurrentPath         2
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and a directory; a directory file
+// grows when its table fills up.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
 #define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
@@ -70,17 +90,22 @@
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
 //	nothing on it, and we need to initialize the disk to contain
-//	an empty directory, and a bitmap of free sectors (with almost but
-//	not all of the sectors marked as free).  
+//	an empty root directory, and a bitmap of free sectors (with almost
+//	but not all of the sectors marked as free).  
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmap and the root directory.
+//
+//	Either way, the root directory goes into the dentry cache, and
+//	stays there.
 //
 //	"format" -- should we initialize the disk?
+//	"atime" -- when opening a file updates its access time
 //----------------------------------------------------------------------
 
-FileSystem::FileSystem(bool format)
+FileSystem::FileSystem(bool format, AtimeMode atime)
 { 
+    atimeMode = atime;
     currentPath[0] = '/';
     currentPath[1] = '\0';
     for(int i=0; i<10; i++)
@@ -89,13 +114,12 @@ FileSystem::FileSystem(bool format)
         memset(OpenFileName[i], 0, sizeof OpenFileName[i]);
         OpenFileInUse[i] = 0;
     }
+    dcache = new DentryCache();
+    freeMap = new BitMap(NumSectors);
+    freeMapLock = new Lock("free map lock");
 
     DEBUG('f', "Initializing the file system.\n");
     if (format) {
-        //currentPath = "/";
-        //strcpy(currentPath, "/");
-        
-        BitMap *freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
@@ -106,6 +130,9 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	for (int i = 0; i < JournalSectors; i++)
+	    freeMap->Mark(JournalStart + i);
+	journal->Format();
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
@@ -141,18 +168,151 @@ FileSystem::FileSystem(bool format)
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
-
-        delete freeMap; 
+	}
 	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
-	}
     } else {
-    // if we are not formatting the disk, just open the files representing
+    // if we are not formatting the disk, first finish whatever was
+    // committed to the journal, then just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
+        journal->Recover();
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        freeMap->FetchFrom(freeMapFile);
     }
+    root = dcache->Enter("/", DirectorySector);	// never released
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	Nachos is halting.  Write back the dirty directories, each in a
+//	transaction of its own, then the headers of the files still open
+//	and what has changed in the free map, in a last transaction that
+//	gets a group to itself; shut the journal down, and close the
+//	bitmap and directory files.  Must be done before the inode table
+//	and "synchDisk" go away.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    dcache->Flush();
+    journal->Commit();
+    journal->Begin();
+    inodeTable->Sync();
+    Sync();
+    journal->End();
+    journal->Shutdown();
+    delete dcache;			// closes the cached directories
+    delete freeMapFile;
+    delete directoryFile;
+    delete freeMap;
+    delete freeMapLock;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AcquireFreeMap
+// 	Lock the map of free sectors, and return it, so the caller can
+//	allocate or free sectors.  Must be followed by ReleaseFreeMap.
+//
+//	A caller growing a file holds the file's inode lock first, so
+//	this lock must not be held while a file (such as a directory)
+//	might grow.
+//----------------------------------------------------------------------
+
+BitMap *
+FileSystem::AcquireFreeMap()
+{
+    freeMapLock->Acquire();
+    return freeMap;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReleaseFreeMap
+// 	Unlock the map of free sectors.  Nothing is written to disk here;
+//	see Sync.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ReleaseFreeMap()
+{
+    freeMapLock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Write the words of the free map that changed since the last Sync
+//	back to the bitmap file.  Such a write is small enough to go into
+//	the file's tail buffer, so it is flushed from there at once, to
+//	be part of the caller's transaction.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Sync()
+{
+    freeMapLock->Acquire();
+    freeMap->Flush(freeMapFile);
+    freeMapFile->Flush();
+    freeMapLock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Resolve
+// 	Return the cached directory named by "path" (of the form "/" or
+//	"/a/b/"), held, or NULL if there is no such directory.  The caller
+//	must Release it.
+//
+//	A path that is not cached is resolved from its parent, so only
+//	the components below the longest cached prefix are looked up.
+//----------------------------------------------------------------------
+
+Dentry *
+FileSystem::Resolve(char *path)
+{
+    char parentPath[PathMaxLen + 1], name[FileNameMaxLen + 1];
+    int len = strlen(path);
+    int start, sector;
+    Dentry *parent, *dentry;
+
+    if ((dentry = dcache->Lookup(path)) != NULL)
+	return dentry;			// includes the root, always cached
+    if (len < 2 || len > PathMaxLen || path[0] != '/' || path[len - 1] != '/')
+	return NULL;
+
+    for (start = len - 2; path[start] != '/'; start--)
+	;				// find the parent's trailing '/'
+    if (len - start - 2 > FileNameMaxLen)
+	return NULL;
+    strncpy(parentPath, path, start + 1);
+    parentPath[start + 1] = '\0';
+    strncpy(name, &path[start + 1], len - start - 2);
+    name[len - start - 2] = '\0';
+
+    if ((parent = Resolve(parentPath)) == NULL)
+	return NULL;
+    parent->lock->AcquireRLock();
+    sector = (!parent->stale && parent->dir->IsDirectory(name))
+				? parent->dir->Find(name) : -1;
+    parent->lock->ReleaseLock();
+    if (sector == -1)
+    {
+	dcache->Release(parent);
+	return NULL;
+    }
+    dentry = dcache->Enter(path, sector);
+
+    // it may have been removed while it was read in
+    parent->lock->AcquireRLock();
+    if (parent->stale || parent->dir->Find(name) != sector)
+	dentry->stale = TRUE;
+    parent->lock->ReleaseLock();
+    dcache->Release(parent);
+    if (dentry->stale)
+    {
+	dcache->Release(dentry);
+	return NULL;
+    }
+    return dentry;
 }
 
 //----------------------------------------------------------------------
@@ -162,86 +322,115 @@ FileSystem::FileSystem(bool format)
 //	to give Create the initial size of the file.
 //
 //	The steps to create a file are:
+//	  Find the directory it goes in
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
 //	  Add the name to the directory
 //	  Store the new file header on disk 
-//	  Flush the changes to the bitmap and the directory back to disk
+//	  If it is a directory, store an empty directory in it
+//	  Flush the changes to the directory back to disk
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
+//	The directory is locked from the check for the name on, so two
+//	threads creating the same name in it cannot both succeed; creates
+//	in different directories only meet at the free map.
+//
 // 	Create fails if:
+//		the directory "targetPath" does not exist
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
-//
 //	"name" -- name of file to be created
-//	"initialSize" -- size of file to be created
+//	"initialSize" -- size of file to be created; ignored for a
+//		directory, which starts out with room for NumDirEntries
+//	"type" -- 'f' for a file, 'd' for a directory
+//	"targetPath" -- the directory to create it in
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Create(char *name, int initialSize, char type, char *targetPath)
 {
-    Directory *directory;
-    BitMap *freeMap;
+    Dentry *dentry;
+    BitMap *map;
     FileHeader *hdr;
     int sector;
     bool success;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
-    printf("try to create type %c file named %s under directory %s with size %d\n",
+    DEBUG('f', "Creating type %c file %s in %s, size %d\n",
         type, name, targetPath, initialSize);
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    if(!directory->existDirectory(targetPath))
+    if ((dentry = Resolve(targetPath)) == NULL)
     {
         printf("no directory named %s when create file %s\n", targetPath, name);
-        success = FALSE;
-        delete directory;
-        return success;
+        return FALSE;
     }
 
-    if (directory->Find(targetPath, name) != -1)
+    journal->Begin();
+    dentry->lock->AcquireWLock();
+    if (dentry->stale)
+    {
+        printf("directory %s was removed when create file %s\n", targetPath, name);
+        dentry->lock->ReleaseLock();
+        journal->End();
+        dcache->Release(dentry);
+        return FALSE;
+    }
+    if (dentry->dir->Find(name) != -1)
     {
         printf("the file named %s already existed\n", name);
-        success = FALSE;          // file is already in directory
-        delete directory;
-        return success;
+        dentry->lock->ReleaseLock();
+        journal->End();
+        dcache->Release(dentry);
+        return FALSE;          // file is already in directory
+    }
+
+    if (type == 'd')
+        initialSize = DirectoryFileSize;
+    map = AcquireFreeMap();
+    sector = map->Find();	// find a sector to hold the file header
+    if (sector == -1) 		
+    {
+        ReleaseFreeMap();
+        success = FALSE;		// no free block for file header
     }
     else 
-    {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
-        sector = freeMap->Find();	// find a sector to hold the file header
-    	if (sector == -1) 		
-            success = FALSE;		// no free block for file header
-        else if(type == 'f' && !directory->Add(name, sector, 'f', targetPath)) 
-            success = FALSE;	// no space in directory
-        else if(type == 'd' && !directory->Add(name, sector, 'd', targetPath))
-            success = FALSE;
-        else 
-        {
-    	   hdr = new FileHeader;
-	       if (!hdr->Allocate(freeMap, initialSize, sector))
-            	success = FALSE;	// no space on disk for data
-	       else 
-           {	
-                success = TRUE;
-		// everthing worked, flush all changes back to disk
-    	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
-    	    	freeMap->WriteBack(freeMapFile);
-	       }
-            delete hdr;
+    {
+        hdr = new FileHeader;
+        success = hdr->Allocate(map, initialSize, sector);
+        if (!success)
+            map->Clear(sector);	// no space on disk for data
+	// the free map must be let go before the directory file can grow
+        ReleaseFreeMap();
+        if (success)
+        {	
+	// everthing worked, flush all changes back to disk
+            hdr->WriteBack(sector); 		
+            if (type == 'd')
+            {
+                OpenFile *newFile = new OpenFile(sector);
+                Directory *newDir = new Directory(NumDirEntries);
+
+                newDir->WriteBack(newFile);
+                delete newDir;
+                delete newFile;
+            }
+            dentry->dir->Add(name, sector, type);
+            if (!dentry->dir->WriteBack(dentry->file))
+            {
+                printf("directory %s could not grow to hold %s\n", targetPath, name);
+                dentry->dir->Remove(name);
+                Deallocate(sector, type == 'd');
+                success = FALSE;
+            }
+            Sync();
         }
-            delete freeMap;
+        delete hdr;
     }
-    delete directory;
+    dentry->lock->ReleaseLock();
+    journal->End();
+    dcache->Release(dentry);
     return success;
 }
 
@@ -250,8 +439,8 @@ bool
 FileSystem::Create(char *name, int initialize, char type)
 {
     
-    printf("in Create function, currentPath is %s\n", currentPath);
-    Create(name, initialize, type, currentPath);
+    DEBUG('f', "Creating %s in the current directory %s\n", name, currentPath);
+    return Create(name, initialize, type, currentPath);
 }
 
 
@@ -262,65 +451,63 @@ FileSystem::Create(char *name, int initialize, char type)
 //	  Find the location of the file's header, using the directory 
 //	  Bring the header into memory
 //
+//	"targetPath" -- the directory holding the file
 //	"name" -- the text name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *targetPath, char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
-
     OpenFile *openFile = NULL;
+    Dentry *dentry;
     int sector;
 
-    DEBUG('f', "Opening file %s\n", name);
+    DEBUG('f', "Opening file %s in %s\n", name, targetPath);
+    if ((dentry = Resolve(targetPath)) == NULL)
+        return NULL;
 
-    directory->FetchFrom(directoryFile);
-    printf("in FileSystem::Open, try to open %s\n", name);
-
-    //directory->PrintTableEntry();
-
-    sector = directory->Find(targetPath, name); 
+    dentry->lock->AcquireWLock();
+    sector = dentry->stale ? -1 : dentry->dir->Find(name); 
     if (sector >= 0) 
     {
-        directory->updateVisitedTime(targetPath, name);
-        directory->updateModified(targetPath, name);
-        directory->AddOpenThreads(targetPath, name);
-        printf("in FileSystem::open, before write back, the fileopenthreads is %d\n", 
-            directory->getFileThreads(targetPath, name));
-        directory->WriteBack(directoryFile);
+        dentry->dir->AddOpenThreads(name);
+        dcache->MarkDirty(dentry);		// written back later
+        DEBUG('f', "File %s is open in %d threads\n", name,
+            dentry->dir->getFileThreads(name));
+    }
+    dentry->lock->ReleaseLock();
+    if (sector >= 0)
+    {
+	// counted as open, so it cannot be removed meanwhile
         openFile = new OpenFile(sector);    // name was found in directory 
-        directory->addThread(targetPath, name);
-        printf("in FileSystem::open, hdr sector found and number is %d\n", sector);
-        delete directory;
-        
-        // directory = new Directory(NumDirEntries);
-        // directory->FetchFrom(directoryFile);
-        // printf("in FileSystem::open, after write back, the fileopenthreads is %d\n", 
-        //     directory->getFileThreads(targetPath, name));
-        // delete directory;
-
-
-
+        DEBUG('f', "File %s has its header at sector %d\n", name, sector);
+
+	// the modification time is in the header, now that we have it
+        dentry->lock->AcquireWLock();
+        if (!dentry->stale
+                && dentry->dir->Accessed(name, atimeMode,
+                                openFile->ModifiedTime()))
+            dcache->MarkDirty(dentry);
+        dentry->lock->ReleaseLock();
     }
     else
-    {
-        printf("in FileSystem::open, sector not found\n"); 
-        delete directory;
-        return NULL; 
-    }		
+        DEBUG('f', "File %s not found\n", name);
+    dcache->Release(dentry);
     return openFile;				// return NULL if not found
 }
 
 void 
 FileSystem::Close(char *targetPath, char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    directory->SubFileThreads(targetPath, name);
-    directory->WriteBack(directoryFile);
-
+    Dentry *dentry = Resolve(targetPath);
 
+    if (dentry == NULL)
+        return;
+    dentry->lock->AcquireWLock();
+    dentry->dir->SubFileThreads(name);
+    dcache->MarkDirty(dentry);
+    dentry->lock->ReleaseLock();
+    dcache->Release(dentry);
 }
 
 
@@ -328,7 +515,7 @@ FileSystem::Close(char *targetPath, char *name)
 OpenFile * 
 FileSystem::Open(char *name)
 {
-    Open(currentPath, name);
+    return Open(currentPath, name);
 }
 
 
@@ -338,89 +525,236 @@ FileSystem::Open(char *name)
 //	    Remove it from the directory
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
-//	    Write changes to directory, bitmap back to disk
+//	    Write changes to directory back to disk
+//
+//	Removing a directory removes everything inside it too.  Like a
+//	file, it is only removed once nothing in it is open any more.
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
 //
+//	"targetPath" -- the directory holding the file
 //	"name" -- the text name of the file to be removed
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Remove(char *targetPath, char *name)
 { 
-    Directory *directory;
-    BitMap *freeMap;
-    FileHeader *fileHdr;
+    char fullPath[PathMaxLen + 1];
+    Dentry *dentry;
     int sector;
+    bool isDir;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    int fileThreadsNum = directory->getFileThreads(targetPath, name);
-    while(fileThreadsNum != 0)
+    if ((dentry = Resolve(targetPath)) == NULL)
+        return FALSE;
+    for (;;)
     {
+        journal->Begin();
+        dentry->lock->AcquireWLock();
+        if (dentry->stale || dentry->dir->Find(name) == -1)
+        {
+            dentry->lock->ReleaseLock();
+            journal->End();
+            dcache->Release(dentry);
+            return FALSE;		// not found, or somebody else removed it
+        }
+        int fileThreadsNum = dentry->dir->getFileThreads(name);
+        if (fileThreadsNum == 0 && dentry->dir->IsDirectory(name)
+                && strlen(targetPath) + strlen(name) + 1 <= PathMaxLen)
+        {
+            sprintf(fullPath, "%s%s/", targetPath, name);
+            fileThreadsNum = OpenBelow(fullPath, dentry->dir->Find(name));
+        }
+        if (fileThreadsNum == 0)
+            break;
         printf("cannot remove %s now, since %d threads still hold the file\n", name, fileThreadsNum);
-        
-        delete directory;
+
+	// let them close it; they need the directory lock to do so
+        dentry->lock->ReleaseLock();
+        journal->End();
         currentThread->Yield();
-        directory = new Directory(NumDirEntries);
-        directory->FetchFrom(directoryFile);
-        fileThreadsNum = directory->getFileThreads(targetPath, name);
     }
    
-    sector = directory->Find(targetPath, name);
-    if (sector == -1) {
-       delete directory;
-       return FALSE;			 // file not found 
-    }
-    if(directory->getThread(targetPath, name) != 0)
-        return FALSE;
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
-
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+    sector = dentry->dir->Find(name);
+    isDir = dentry->dir->IsDirectory(name);
 
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
-    freeMap->Clear(sector);			// remove header block
-    directory->Remove(targetPath, name);
-
-    freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
-    printf("in FileSystem::remove, successfully remove file %s\n", name);
-    delete fileHdr;
-    delete directory;
-    delete freeMap;
+    // forget the cached directories below first, so the flusher cannot
+    // write one of them into its freed sectors
+    if (isDir && strlen(targetPath) + strlen(name) + 1 <= PathMaxLen)
+    {
+        sprintf(fullPath, "%s%s/", targetPath, name);
+        dcache->Purge(fullPath);
+    }
+    Deallocate(sector, isDir);
+    dentry->dir->Remove(name);
+
+    dentry->dir->WriteBack(dentry->file);       // flush to disk
+    Sync();
+    dentry->lock->ReleaseLock();
+    journal->End();
+    DEBUG('f', "Removed file %s\n", name);
+    dcache->Release(dentry);
     return TRUE;
 } 
 
 bool 
 FileSystem::Remove(char *name)
 {
-    Remove(currentPath, name);
+    return Remove(currentPath, name);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenBelow
+// 	Return how many times files in the directory "path", whose header
+//	is at "sector", and in its subdirectories are open.
+//
+//	The open counts of a cached directory are only up to date in the
+//	cache, so it is read from there; any other one is read from disk.
+//	The caller holds the parent of "path" locked.
+//----------------------------------------------------------------------
+
+int
+FileSystem::OpenBelow(char *path, int sector)
+{
+    char subPath[PathMaxLen + 1];
+    Dentry *dentry = dcache->Lookup(path);
+    OpenFile *file = NULL;
+    Directory *dir;
+    int count = 0;
+
+    if (dentry != NULL)
+    {
+        dentry->lock->AcquireRLock();
+        dir = dentry->dir;
+    }
+    else
+    {
+        file = new OpenFile(sector);
+        dir = new Directory(NumDirEntries);
+        dir->FetchFrom(file);
+    }
+    for (int i = 0; i < dir->getTableSize(); i++)
+    {
+        DirectoryEntry *entry = dir->getEntry(i);
+
+        if (entry == NULL)
+            continue;
+        count += entry->openThreads;
+        if (entry->type == 'd'
+                && strlen(path) + strlen(entry->name) + 1 <= PathMaxLen)
+        {
+            sprintf(subPath, "%s%s/", path, entry->name);
+            count += OpenBelow(subPath, entry->sector);
+        }
+    }
+    if (dentry != NULL)
+    {
+        dentry->lock->ReleaseLock();
+        dcache->Release(dentry);
+    }
+    else
+    {
+        delete dir;
+        delete file;
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Deallocate
+// 	Give back to the free map the header and data blocks of the file
+//	whose header is at "sector".  For a directory, first do the same
+//	for everything in it.
+//
+//	The blocks are taken from the in-core copy of the header, the
+//	latest one, with its inode locked.  The free map is only locked
+//	while bits are cleared: a thread growing a file holds the file's
+//	inode lock and then takes the free map, so the free map must never
+//	be held while waiting for an inode, or for the disk to read a
+//	directory in.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Deallocate(int sector, bool isDir)
+{
+    Inode *inode;
+
+    if (isDir)
+    {
+        OpenFile *file = new OpenFile(sector);
+        Directory *dir = new Directory(NumDirEntries);
+
+        dir->FetchFrom(file);
+        for (int i = 0; i < dir->getTableSize(); i++)
+        {
+            DirectoryEntry *entry = dir->getEntry(i);
+
+            if (entry != NULL)
+                Deallocate(entry->sector, entry->type == 'd');
+        }
+        delete dir;
+        delete file;
+    }
+
+    inode = inodeTable->Get(sector);
+    inode->lock->AcquireWLock();
+    inode->dirty = FALSE;			// no point writing it back
+    inode->tailBlock = -1;
+    inode->hdr.Deallocate(AcquireFreeMap());  	// remove data blocks
+    ReleaseFreeMap();
+    inode->lock->ReleaseLock();
+    inodeTable->Put(inode);
+
+    // not before the inode is gone, or a file created in the sector
+    // would find it
+    AcquireFreeMap()->Clear(sector);		// remove header block
+    ReleaseFreeMap();
 }
 
 
 //----------------------------------------------------------------------
 // FileSystem::List
-// 	List all the files in the file system directory.
+// 	List all the files in the file system, one full path per line,
+//	starting from the root directory.
 //----------------------------------------------------------------------
 
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    ListTree("/");
+}
+
+void
+FileSystem::ListTree(char *path)
+{
+    char subPath[PathMaxLen + 1];
+    Dentry *dentry = Resolve(path);
+    char (*subDirs)[FileNameMaxLen + 1];
+    int numSubDirs;
 
-    directory->FetchFrom(directoryFile);
-    directory->List();
-    delete directory;
+    if (dentry == NULL)
+        return;
+    dentry->lock->AcquireRLock();
+    dentry->dir->List(path);
+    subDirs = new char[dentry->dir->getTableSize()][FileNameMaxLen + 1];
+    numSubDirs = SubDirectories(dentry->dir, subDirs);
+    dentry->lock->ReleaseLock();
+    dcache->Release(dentry);
+
+    for (int i = 0; i < numSubDirs; i++)
+        if (strlen(path) + strlen(subDirs[i]) + 1 <= PathMaxLen)
+        {
+            sprintf(subPath, "%s%s/", path, subDirs[i]);
+            ListTree(subPath);
+        }
+    delete [] subDirs;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Print
 // 	Print everything about the file system:
 //	  the contents of the bitmap
-//	  the contents of the directory
+//	  the contents of the root directory
 //	  for each file in the directory,
 //	      the contents of the file header
 //	      the data in the file
@@ -431,8 +765,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -442,43 +774,31 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
-    freeMap->Print();
+    AcquireFreeMap()->Print();
+    ReleaseFreeMap();
 
-    directory->FetchFrom(directoryFile);
     printf("Directory situation are listed as follows:\n");
-    directory->Print();
+    root->lock->AcquireRLock();
+    root->dir->Print();
+    root->lock->ReleaseLock();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
 } 
 
 
 bool 
 FileSystem::changeDirectory(char *newPath)
 {
-    if(!strcmp("/", newPath))
-    {
-        strncpy(currentPath, "/", 100);
-        //currentPath = "/";
-        return TRUE;
-    }
+    Dentry *dentry = Resolve(newPath);
 
-
-    Directory *directory;    
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    if(directory->existDirectory(newPath))
+    if (dentry != NULL)
     {
         strncpy(currentPath, newPath, 100);
-        delete directory;
+        dcache->Release(dentry);
         return TRUE;
     }
     printf("no such directory!\n");
-    //delete fullPath;
-    delete directory;
     return FALSE;
 
 }
@@ -523,7 +843,7 @@ FileSystem::SysCallWrite(char *buffer, int Bytes, int id)
 {
     //OpenFile *openfile = new OpenFile(fileId);
     //openfile->Write(content, size);
-    printf("OpenFileInUse[%d] is in use\n", id);
+    DEBUG('f', "Writing %d bytes to open file %d\n", Bytes, id);
     if(OpenFileInUse[id] == 0)
     {
         printf("the write file %d is not opened yet\n", id);
@@ -550,25 +870,78 @@ FileSystem::SysCallRead(char *buffer, int Bytes, int id)
 int 
 FileSystem::getFileThreadsNum(char *targetPath, char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    int returnNum = directory->getFileThreads(targetPath, name);
-    delete directory;
+    Dentry *dentry = Resolve(targetPath);
+    int returnNum;
+
+    ASSERT(dentry != NULL);
+    dentry->lock->AcquireRLock();
+    returnNum = dentry->dir->getFileThreads(name);
+    dentry->lock->ReleaseLock();
+    dcache->Release(dentry);
     return returnNum;
-    
 }
 
 
+//----------------------------------------------------------------------
+// FileSystem::cleanFileThreadsNum
+// 	Forget every open count, in every directory.
+//----------------------------------------------------------------------
+
 void 
 FileSystem::cleanFileThreadsNum()
 {
-    Directory *directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    directory->cleanThreadsNum();
-    directory->WriteBack(directoryFile);
-    delete directory;
+    CleanTree("/");
 }
 
+void
+FileSystem::CleanTree(char *path)
+{
+    char subPath[PathMaxLen + 1];
+    Dentry *dentry = Resolve(path);
+    char (*subDirs)[FileNameMaxLen + 1];
+    int numSubDirs;
 
+    if (dentry == NULL)
+        return;
+    dentry->lock->AcquireWLock();
+    dentry->dir->cleanThreadsNum();
+    dcache->MarkDirty(dentry);
+    subDirs = new char[dentry->dir->getTableSize()][FileNameMaxLen + 1];
+    numSubDirs = SubDirectories(dentry->dir, subDirs);
+    dentry->lock->ReleaseLock();
+    dcache->Release(dentry);
+
+    for (int i = 0; i < numSubDirs; i++)
+        if (strlen(path) + strlen(subDirs[i]) + 1 <= PathMaxLen)
+        {
+            sprintf(subPath, "%s%s/", path, subDirs[i]);
+            CleanTree(subPath);
+        }
+    delete [] subDirs;
+}
 
+//----------------------------------------------------------------------
+// FileSystem::SubDirectories
+// 	Copy the names of the subdirectories of "dir" into "names", which
+//	has room for one per entry, and return how many there are.
+//
+//	ListTree and CleanTree go down into them only once they have let
+//	go of "dir": resolving one may have to go back up to "dir", and a
+//	directory's lock is never waited for while one below it is held
+//	(cf. DentryCache::Purge).
+//----------------------------------------------------------------------
+
+int
+FileSystem::SubDirectories(Directory *dir, char (*names)[FileNameMaxLen + 1])
+{
+    int count = 0;
 
+    for (int i = 0; i < dir->getTableSize(); i++)
+    {
+        DirectoryEntry *entry = dir->getEntry(i);
+
+        if (entry != NULL && entry->type == 'd')
+            strcpy(names[count++], entry->name);
+    }
+    return count;
+}
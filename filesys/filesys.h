@@ -69,15 +69,33 @@ class FileSystem {
 //#endif
 
 #else // FILESYS
+#include "directory.h"
+
 //#ifdef FILESYS_ADV
+class Directory;
+class DentryCache;
+class Dentry;
+class BitMap;
+class Lock;
+
 class FileSystem {
   public:
-    FileSystem(bool format);		// Initialize the file system.
+    FileSystem(bool format, AtimeMode atime = AtimeRelative);
+					// Initialize the file system.
 					// Must be called *after* "synchDisk" 
 					// has been initialized.
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+					// "atime" says when opening a file
+					// updates its access time.
+    ~FileSystem();			// Sync, then close everything
+
+    BitMap *AcquireFreeMap();		// Lock the map of free sectors,
+					// and return it
+    void ReleaseFreeMap();		// Unlock it again
+    void Sync();			// Write the changed parts of the
+					// free map back to disk
 
     bool Create(char *name, int initialSize, char type, char *targetPath);  	
 					// Create a file (UNIX creat)
@@ -119,12 +137,28 @@ class FileSystem {
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
+   BitMap* freeMap;			// The same bit map, in memory; this
+					// copy is the authoritative one
+   Lock* freeMapLock;			// Protects "freeMap"
    OpenFile* directoryFile;		// "Root" directory -- list of 
-   char currentPath[100];
 					// file names, represented as a file
+   DentryCache* dcache;			// Directories recently looked up
+   AtimeMode atimeMode;			// When to update access times
+   Dentry* root;			// The root directory, always cached
+   char currentPath[100];
    OpenFile* OpenFileQueue[10];
    char OpenFileName[10][255];
    int  OpenFileInUse[10];
+
+   Dentry *Resolve(char *path);		// Find the directory "path"
+   void Deallocate(int sector, bool isDir);
+					// Free a file, or a whole subtree
+   int OpenBelow(char *path, int sector);
+					// Count opens of files in "path"
+   void ListTree(char *path);		// List "path" and below
+   void CleanTree(char *path);		// Zero open counts in "path" and below
+   int SubDirectories(Directory *dir, char (*names)[FileNameMaxLen + 1]);
+					// Names of the directories in "dir"
 };
 
 #endif // FILESYS
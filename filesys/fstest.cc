@@ -6,7 +6,10 @@
 //	   Print -- cat the contents of a Nachos file 
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
-//		(won't work on baseline system!)
+//		(won't work on baseline system!), and read and write
+//		files from several threads at once
+//	   Benchmark -- time a set of standard workloads, and print
+//		the results in a form scripts can read
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +19,7 @@
 
 #include "utility.h"
 #include "filesys.h"
+#include "dcache.h"
 #include "system.h"
 #include "thread.h"
 #include "disk.h"
@@ -333,6 +337,184 @@ void FileExclusive()
 }
 
 
+//----------------------------------------------------------------------
+// ConcurrentTest
+// 	Stress the file system's locking: run the same jobs twice, first
+//	one after another in this thread, then each in a thread of its
+//	own, and print how long each way took.  Three sets of jobs:
+//	  readers -- ConcurrentJobs threads reading one shared file
+//	  writers -- ConcurrentJobs threads, each writing a file of its own
+//	  mixed   -- both at once
+//
+//	Readers of a file share its inode lock, and writers to different
+//	files take different ones, so the threads only wait for the disk.
+//	They finish sooner than the serial jobs when the disk can work on
+//	several requests at once (-dm ssd or nvme, or -dn with -dr), and
+//	when reads go to the disk at all (-bc 0).
+//
+//	Implemented as:
+//	  ReadJob, WriteJob -- one job
+//	  ReaderThread, WriterThread -- a job, run in a thread of its own
+//	  RunJobs -- run a set of jobs both ways, and print the times
+//----------------------------------------------------------------------
+
+#define ConcurrentJobs 	4
+#define SharedFileName 	"SharedFile"
+#define JobFileSize 	(SectorSize * 64)
+
+static Semaphore *jobsDone;		// V'ed as each job thread finishes
+
+static void
+FillBlock(char *block, int n)		// what block "n" of a file holds
+{
+    memset(block, 'a' + n % 26, SectorSize);
+}
+
+static void
+ReadJob(int which)
+{
+    char block[SectorSize], expected[SectorSize];
+    OpenFile *openFile = fileSystem->Open("/", SharedFileName);
+
+    if (openFile == NULL) {
+	printf("Perf test: reader %d unable to open %s\n", which,
+							SharedFileName);
+	return;
+    }
+    for (int n = 0; n < JobFileSize / SectorSize; n++) {
+	FillBlock(expected, n);
+	if (openFile->Read(block, SectorSize) < SectorSize
+				|| bcmp(block, expected, SectorSize)) {
+	    printf("Perf test: reader %d unable to read %s\n", which,
+							SharedFileName);
+	    break;
+	}
+    }
+    delete openFile;
+    fileSystem->Close("/", SharedFileName);
+}
+
+static void
+WriteJob(int which)
+{
+    char name[FileNameMaxLen + 1], block[SectorSize];
+    OpenFile *openFile;
+
+    sprintf(name, "Job%d", which);
+    if ((openFile = fileSystem->Open("/", name)) == NULL) {
+	printf("Perf test: writer %d unable to open %s\n", which, name);
+	return;
+    }
+    for (int n = 0; n < JobFileSize / SectorSize; n++) {
+	FillBlock(block, n);
+	if (openFile->Write(block, SectorSize) < SectorSize) {
+	    printf("Perf test: writer %d unable to write %s\n", which, name);
+	    break;
+	}
+    }
+    delete openFile;
+    fileSystem->Close("/", name);
+}
+
+static void
+ReaderThread(int which)
+{
+    ReadJob(which);
+    jobsDone->V();
+}
+
+static void
+WriterThread(int which)
+{
+    WriteJob(which);
+    jobsDone->V();
+}
+
+static void
+EmptyJobFiles()				// so every run of writers grows them
+{
+    char name[FileNameMaxLen + 1];
+
+    for (int i = 0; i < ConcurrentJobs; i++) {
+	sprintf(name, "Job%d", i);
+	fileSystem->Remove("/", name);
+	if (!fileSystem->Create(name, 0, 'f', "/"))
+	    printf("Perf test: can't create %s\n", name);
+    }
+}
+
+static void
+RunJobs(char *title, bool readers, bool writers)
+{
+    int i, jobs = 0;
+    int start, reads, writes, serialTicks, serialReads, serialWrites;
+
+    EmptyJobFiles();
+    start = stats->totalTicks;
+    reads = stats->numDiskReads;
+    writes = stats->numDiskWrites;
+    for (i = 0; i < ConcurrentJobs; i++) {
+	if (readers)
+	    ReadJob(i);
+	if (writers)
+	    WriteJob(i);
+    }
+    serialTicks = stats->totalTicks - start;
+    serialReads = stats->numDiskReads - reads;
+    serialWrites = stats->numDiskWrites - writes;
+
+    EmptyJobFiles();
+    start = stats->totalTicks;
+    reads = stats->numDiskReads;
+    writes = stats->numDiskWrites;
+    for (i = 0; i < ConcurrentJobs; i++) {
+	if (readers) {
+	    (new Thread("reader"))->Fork(ReaderThread, i);
+	    jobs++;
+	}
+	if (writers) {
+	    (new Thread("writer"))->Fork(WriterThread, i);
+	    jobs++;
+	}
+    }
+    while (jobs-- > 0)
+	jobsDone->P();
+
+    printf("%s: serial %d ticks (%d disk reads, %d writes), "
+	"%d threads %d ticks (%d disk reads, %d writes)\n", title,
+	serialTicks, serialReads, serialWrites,
+	(readers + writers) * ConcurrentJobs, stats->totalTicks - start,
+	stats->numDiskReads - reads, stats->numDiskWrites - writes);
+}
+
+static void
+ConcurrentTest()
+{
+    char block[SectorSize];
+    OpenFile *openFile;
+
+    printf("Concurrent access: %d jobs of %d bytes each, in %d byte "
+	"chunks\n", ConcurrentJobs, JobFileSize, SectorSize);
+    fileSystem->Remove("/", SharedFileName);
+    if (!fileSystem->Create(SharedFileName, 0, 'f', "/")
+		|| (openFile = fileSystem->Open("/", SharedFileName)) == NULL) {
+	printf("Perf test: can't create %s\n", SharedFileName);
+	return;
+    }
+    for (int n = 0; n < JobFileSize / SectorSize; n++) {
+	FillBlock(block, n);
+	openFile->Write(block, SectorSize);
+    }
+    delete openFile;
+    fileSystem->Close("/", SharedFileName);
+
+    jobsDone = new Semaphore("jobs done", 0);
+    RunJobs("readers", TRUE, FALSE);
+    RunJobs("writers", FALSE, TRUE);
+    RunJobs("mixed", TRUE, TRUE);
+    delete jobsDone;
+}
+
 void
 PerformanceTest()
 {
@@ -340,6 +522,7 @@ PerformanceTest()
     //stats->Print();
     //FileWrite();
     FileExclusive();
+    ConcurrentTest();
     //testFunction();
     /*
     FileRead();
@@ -355,3 +538,414 @@ PerformanceTest()
     
 }
 
+
+//----------------------------------------------------------------------
+// Benchmark
+// 	Measure the file system under a set of standard workloads, so
+//	that a change to it can be judged by numbers rather than by eye.
+//	"which" picks the workloads:
+//	  seq    -- sequential write, then read, of a file, at several
+//		    chunk sizes ("seqwrite", "seqread")
+//	  random -- random writes, then reads, of chunks of a file, at
+//		    the same chunk sizes ("randwrite", "randread")
+//	  meta   -- a storm of creates, then of deletes ("create",
+//		    "delete")
+//	  lookup -- opening and closing files picked at random among
+//		    many directories, more than the dentry cache holds
+//		    ("lookup")
+//	  mixed  -- the same mix of reads, appends, creates and deletes,
+//		    split over 1, 2, 4 and 8 threads ("mixed")
+//	  all    -- every one of the above, in that order
+//
+//	Every measurement is printed as one line of its own, so it can
+//	be picked out of the rest of the output with "grep ^BENCH":
+//
+//	  BENCH workload=<name> chunk=<bytes per op> threads=<n> ops=<n>
+//	      bytes=<n> ticks=<n> disk_reads=<n> disk_writes=<n>
+//	      wall_us=<n>
+//
+//	(all on one line).  "ticks" is simulated time, and "disk_reads"
+//	and "disk_writes" count requests that reached the disk; "wall_us"
+//	is how long the host took, in microseconds, which includes any
+//	debugging output, so leave -d f off.  The workloads run in
+//	the directory BenchDir, created empty first and removed at the
+//	end, and use the same pseudo-random choices every time.  Reads
+//	come from the sector cache when they can; -bc 0 sends them all to
+//	the disk.
+//----------------------------------------------------------------------
+
+#define BenchDir 	"/bench/"
+#define BenchNameLen 	15		// longest name of a file or directory
+					// in BenchDir, so that paths made
+					// of the two fit in PathMaxLen
+#define BenchFileSize 	(SectorSize * 512)	// 64KB
+#define NumChunkSizes 	4
+#define MaxChunk 	(SectorSize * 32)
+#define BenchFiles 	128		// files in the create/delete storm
+#define BenchDirs 	32		// directories for the lookup test,
+#define BenchDirFiles 	8		// and files in each
+#define BenchLookups 	1024
+#define BenchMixedOps 	512		// operations of the mixed workload,
+					// all threads together
+#define BenchMaxThreads 8
+
+static int chunkSizes[NumChunkSizes] = { 16, SectorSize, SectorSize * 8,
+						MaxChunk };
+static unsigned int benchSeed;		// state of NextRandom
+
+// Counters at the start of a measurement.
+
+struct BenchSample {
+    int ticks;
+    int diskReads;
+    int diskWrites;
+    double wall;
+};
+
+//----------------------------------------------------------------------
+// NextRandom
+// 	Return a pseudo-random number in [0, n).  Not Random(), so that
+//	the choices do not depend on -rs, nor change what it does.
+//----------------------------------------------------------------------
+
+static int
+NextRandom(int n)
+{
+    benchSeed = benchSeed * 1103515245 + 12345;
+    return (benchSeed >> 16) % n;
+}
+
+static void
+StartSample(BenchSample *sample)
+{
+    sample->ticks = stats->totalTicks;
+    sample->diskReads = stats->numDiskReads;
+    sample->diskWrites = stats->numDiskWrites;
+    sample->wall = WallTime();
+}
+
+static void
+Report(BenchSample *sample, char *workload, int chunk, int numThreads, int ops,
+								int bytes)
+{
+    printf("BENCH workload=%s chunk=%d threads=%d ops=%d bytes=%d "
+	"ticks=%d disk_reads=%d disk_writes=%d wall_us=%d\n", workload,
+	chunk, numThreads, ops, bytes, stats->totalTicks - sample->ticks,
+	stats->numDiskReads - sample->diskReads,
+	stats->numDiskWrites - sample->diskWrites,
+	(int) ((WallTime() - sample->wall) * 1000000));
+}
+
+//----------------------------------------------------------------------
+// OpenBenchFile, CloseBenchFile
+// 	Open a file of the benchmark, creating it if "create" is set, or
+//	close it.  Every Open is matched by a Close, so that the file can
+//	be removed afterwards.
+//----------------------------------------------------------------------
+
+static OpenFile *
+OpenBenchFile(char *path, char *name, bool create)
+{
+    OpenFile *openFile;
+
+    if (create && !fileSystem->Create(name, 0, 'f', path)) {
+	printf("Benchmark: can't create %s%s\n", path, name);
+	return NULL;
+    }
+    if ((openFile = fileSystem->Open(path, name)) == NULL)
+	printf("Benchmark: unable to open %s%s\n", path, name);
+    return openFile;
+}
+
+static void
+CloseBenchFile(OpenFile *openFile, char *path, char *name)
+{
+    delete openFile;
+    fileSystem->Close(path, name);
+}
+
+//----------------------------------------------------------------------
+// FillBenchFile
+// 	Write "size" bytes to a new file, in big chunks, without timing
+//	it; the file that the workload itself then reads or rewrites.
+//----------------------------------------------------------------------
+
+static bool
+FillBenchFile(char *name, int size)
+{
+    char *buffer = new char[MaxChunk];
+    OpenFile *openFile = OpenBenchFile(BenchDir, name, TRUE);
+    bool success = (openFile != NULL);
+
+    memset(buffer, 'x', MaxChunk);
+    for (int pos = 0; success && pos < size; pos += MaxChunk)
+	success = (openFile->Write(buffer, MaxChunk) == MaxChunk);
+    if (openFile != NULL)
+	CloseBenchFile(openFile, BenchDir, name);
+    delete [] buffer;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// BenchSequential
+// 	At each chunk size, write a new file from start to end, then read
+//	it back, then remove it.
+//----------------------------------------------------------------------
+
+static void
+BenchSequential()
+{
+    char *buffer = new char[MaxChunk];
+    BenchSample sample;
+    OpenFile *openFile;
+
+    memset(buffer, 's', MaxChunk);
+    for (int c = 0; c < NumChunkSizes; c++) {
+	int chunk = chunkSizes[c], ops = BenchFileSize / chunk, i;
+
+	if ((openFile = OpenBenchFile(BenchDir, "seq", TRUE)) == NULL)
+	    break;
+	StartSample(&sample);
+	for (i = 0; i < ops; i++)
+	    if (openFile->Write(buffer, chunk) < chunk)
+		break;
+	Report(&sample, "seqwrite", chunk, 1, i, i * chunk);
+
+	openFile->Seek(0);
+	StartSample(&sample);
+	for (i = 0; i < ops; i++)
+	    if (openFile->Read(buffer, chunk) < chunk)
+		break;
+	Report(&sample, "seqread", chunk, 1, i, i * chunk);
+
+	CloseBenchFile(openFile, BenchDir, "seq");
+	fileSystem->Remove(BenchDir, "seq");
+    }
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// BenchRandom
+// 	At each chunk size, overwrite, then read, as many chunks of a
+//	file as it holds, each at a chunk boundary picked at random.
+//----------------------------------------------------------------------
+
+static void
+BenchRandom()
+{
+    char *buffer = new char[MaxChunk];
+    BenchSample sample;
+    OpenFile *openFile;
+
+    memset(buffer, 'r', MaxChunk);
+    if (!FillBenchFile("rand", BenchFileSize)
+		|| (openFile = OpenBenchFile(BenchDir, "rand", FALSE)) == NULL) {
+	delete [] buffer;
+	return;
+    }
+    for (int c = 0; c < NumChunkSizes; c++) {
+	int chunk = chunkSizes[c], ops = BenchFileSize / chunk, i;
+
+	StartSample(&sample);
+	for (i = 0; i < ops; i++)
+	    if (openFile->WriteAt(buffer, chunk,
+			NextRandom(BenchFileSize / chunk) * chunk) < chunk)
+		break;
+	Report(&sample, "randwrite", chunk, 1, i, i * chunk);
+
+	StartSample(&sample);
+	for (i = 0; i < ops; i++)
+	    if (openFile->ReadAt(buffer, chunk,
+			NextRandom(BenchFileSize / chunk) * chunk) < chunk)
+		break;
+	Report(&sample, "randread", chunk, 1, i, i * chunk);
+    }
+    CloseBenchFile(openFile, BenchDir, "rand");
+    fileSystem->Remove(BenchDir, "rand");
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// BenchMetadata
+// 	Create BenchFiles empty files in a directory of their own, then
+//	remove them all.
+//----------------------------------------------------------------------
+
+static void
+BenchMetadata()
+{
+    char path[] = BenchDir "storm/";
+    char name[BenchNameLen + 1];
+    BenchSample sample;
+    int i, done;
+
+    if (!fileSystem->Create("storm", 0, 'd', BenchDir))
+	return;
+    StartSample(&sample);
+    for (i = done = 0; i < BenchFiles; i++) {
+	sprintf(name, "f%d", i);
+	if (fileSystem->Create(name, 0, 'f', path))
+	    done++;
+    }
+    Report(&sample, "create", 0, 1, done, 0);
+
+    StartSample(&sample);
+    for (i = done = 0; i < BenchFiles; i++) {
+	sprintf(name, "f%d", i);
+	if (fileSystem->Remove(path, name))
+	    done++;
+    }
+    Report(&sample, "delete", 0, 1, done, 0);
+    fileSystem->Remove(BenchDir, "storm");
+}
+
+//----------------------------------------------------------------------
+// BenchLookup
+// 	Spread files over BenchDirs directories, then open and close
+//	BenchLookups of them, picked at random, by directory path and
+//	name.
+//----------------------------------------------------------------------
+
+static void
+BenchLookup()
+{
+    char dirName[BenchNameLen + 1], name[BenchNameLen + 1];
+    char path[PathMaxLen + 1];
+    BenchSample sample;
+    OpenFile *openFile;
+    int i, done;
+
+    for (i = 0; i < BenchDirs; i++) {
+	sprintf(dirName, "d%d", i);
+	sprintf(path, "%s%s/", BenchDir, dirName);
+	if (!fileSystem->Create(dirName, 0, 'd', BenchDir))
+	    return;
+	for (int f = 0; f < BenchDirFiles; f++) {
+	    sprintf(name, "f%d", f);
+	    fileSystem->Create(name, 0, 'f', path);
+	}
+    }
+
+    StartSample(&sample);
+    for (i = done = 0; i < BenchLookups; i++) {
+	sprintf(path, "%sd%d/", BenchDir, NextRandom(BenchDirs));
+	sprintf(name, "f%d", NextRandom(BenchDirFiles));
+	if ((openFile = fileSystem->Open(path, name)) != NULL) {
+	    CloseBenchFile(openFile, path, name);
+	    done++;
+	}
+    }
+    Report(&sample, "lookup", 0, 1, done, 0);
+
+    for (i = 0; i < BenchDirs; i++) {
+	sprintf(dirName, "d%d", i);
+	fileSystem->Remove(BenchDir, dirName);
+    }
+}
+
+//----------------------------------------------------------------------
+// BenchMixed
+// 	Split BenchMixedOps operations over 1, 2, 4 and 8 threads.  Half
+//	the operations read a sector of a shared file at random, a
+//	quarter append a sector to the thread's own file, and a quarter
+//	create and remove a file of the thread's own.
+//
+//	MixedThread is the body of each thread; "which" is its number.
+//----------------------------------------------------------------------
+
+static int mixedOpsEach;		// operations per thread
+
+static void
+MixedThread(int which)
+{
+    char own[BenchNameLen + 1], temp[BenchNameLen + 1];
+    char buffer[SectorSize];
+    OpenFile *shared, *appended;
+
+    sprintf(own, "m%d", which);
+    sprintf(temp, "t%d", which);
+    memset(buffer, 'm', SectorSize);
+    shared = OpenBenchFile(BenchDir, "shared", FALSE);
+    appended = OpenBenchFile(BenchDir, own, TRUE);
+    for (int i = 0; shared != NULL && appended != NULL
+					&& i < mixedOpsEach; i++) {
+	switch (i % 4) {
+	  case 0:
+	  case 2:
+	    shared->ReadAt(buffer, SectorSize,
+		NextRandom(BenchFileSize / SectorSize) * SectorSize);
+	    break;
+	  case 1:
+	    appended->Write(buffer, SectorSize);
+	    break;
+	  case 3:
+	    if (fileSystem->Create(temp, 0, 'f', BenchDir))
+		fileSystem->Remove(BenchDir, temp);
+	    break;
+	}
+    }
+    if (shared != NULL)
+	CloseBenchFile(shared, BenchDir, "shared");
+    if (appended != NULL)
+	CloseBenchFile(appended, BenchDir, own);
+    jobsDone->V();
+}
+
+static void
+BenchMixed()
+{
+    char own[BenchNameLen + 1];
+    BenchSample sample;
+
+    if (!FillBenchFile("shared", BenchFileSize))
+	return;
+    jobsDone = new Semaphore("jobs done", 0);
+    for (int numThreads = 1; numThreads <= BenchMaxThreads; numThreads *= 2) {
+	mixedOpsEach = BenchMixedOps / numThreads;
+	StartSample(&sample);
+	for (int i = 0; i < numThreads; i++)
+	    (new Thread("mixed"))->Fork(MixedThread, i);
+	for (int i = 0; i < numThreads; i++)
+	    jobsDone->P();
+	Report(&sample, "mixed", SectorSize, numThreads,
+			mixedOpsEach * numThreads, 0);
+
+	for (int i = 0; i < numThreads; i++) {
+	    sprintf(own, "m%d", i);
+	    fileSystem->Remove(BenchDir, own);
+	}
+    }
+    delete jobsDone;
+    fileSystem->Remove(BenchDir, "shared");
+}
+
+void
+Benchmark(char *which)
+{
+    bool all = !strcmp(which, "all");
+
+    if (!all && strcmp(which, "seq") && strcmp(which, "random")
+		&& strcmp(which, "meta") && strcmp(which, "lookup")
+		&& strcmp(which, "mixed")) {
+	printf("Benchmark: no workload %s; try seq, random, meta, lookup, "
+		"mixed or all\n", which);
+	return;
+    }
+    benchSeed = 1;
+    fileSystem->Remove("/", "bench");	// left over from a crash
+    if (!fileSystem->Create("bench", 0, 'd', "/")) {
+	printf("Benchmark: can't create %s\n", BenchDir);
+	return;
+    }
+    if (all || !strcmp(which, "seq"))
+	BenchSequential();
+    if (all || !strcmp(which, "random"))
+	BenchRandom();
+    if (all || !strcmp(which, "meta"))
+	BenchMetadata();
+    if (all || !strcmp(which, "lookup"))
+	BenchLookup();
+    if (all || !strcmp(which, "mixed"))
+	BenchMixed();
+    fileSystem->Remove("/", "bench");
+}
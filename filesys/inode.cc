@@ -0,0 +1,159 @@
+// inode.cc
+//	Routines to manage the in-core inode table.  See inode.h.
+//
+//	Reading a header in, or writing one back, waits for the disk, so
+//	the table is protected by a lock rather than by turning
+//	interrupts off.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "inode.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// InodeTable::InodeTable
+// 	Initialize the table; initially no file is open.
+//----------------------------------------------------------------------
+
+InodeTable::InodeTable()
+{
+    lock = new Lock("inode table lock");
+    for (int i = 0; i < MaxInodes; i++) {
+	inodes[i].sector = -1;
+	inodes[i].refCount = 0;
+	inodes[i].dirty = FALSE;
+	inodes[i].lock = new RWLock("inode lock");
+	inodes[i].tailBlock = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::~InodeTable
+// 	Nachos is halting.  Files still open are never closed, so write
+//	their headers back before the disk goes away.
+//----------------------------------------------------------------------
+
+InodeTable::~InodeTable()
+{
+    Sync();
+    for (int i = 0; i < MaxInodes; i++)
+	delete inodes[i].lock;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Get
+// 	Return the in-core inode for the file header at "sector", with
+//	one more reference.  The header is read from disk only if the
+//	file is not open already.
+//
+//	Like the Unix inode table, this one has a fixed size; running
+//	out of slots is fatal.
+//----------------------------------------------------------------------
+
+Inode *
+InodeTable::Get(int sector)
+{
+    Inode *inode = NULL;
+
+    lock->Acquire();
+    for (int i = 0; i < MaxInodes; i++) {
+	if (inodes[i].sector == sector) {
+	    inodes[i].refCount++;
+	    lock->Release();
+	    return &inodes[i];
+	}
+	if (inode == NULL && inodes[i].sector == -1)
+	    inode = &inodes[i];
+    }
+    ASSERT(inode != NULL);		// inode table overflow
+
+    inode->sector = sector;
+    inode->refCount = 1;
+    inode->dirty = FALSE;
+    inode->tailBlock = -1;
+    inode->hdr.FetchFrom(sector);
+    inode->hdr.LoadMap();		// before readers share it
+    DEBUG('f', "Read in inode for header at sector %d\n", sector);
+    lock->Release();
+    return inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Put
+// 	Drop one reference to "inode".  When the last OpenFile on the
+//	file is closed, write the header back if it changed, and free
+//	the slot.
+//
+//	A header changes when the file grows, and so does the free map;
+//	both are written in one transaction, so that after a crash the
+//	map never has a block of the file marked free.
+//----------------------------------------------------------------------
+
+void
+InodeTable::Put(Inode *inode)
+{
+    bool wroteHeader = FALSE;
+
+    journal->Begin();
+    lock->Acquire();
+    ASSERT(inode->refCount > 0);
+    if (--inode->refCount == 0) {
+	inode->FlushTail();
+	if (inode->dirty) {
+	    DEBUG('f', "Writing back inode at sector %d\n", inode->sector);
+	    inode->hdr.WriteBack(inode->sector);
+	    wroteHeader = TRUE;
+	}
+	inode->dirty = FALSE;
+	inode->sector = -1;
+    }
+    lock->Release();
+    if (wroteHeader && fileSystem != NULL)
+	fileSystem->Sync();
+    journal->End();
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Sync
+// 	Write back the buffered tail block and the header of every open
+//	file that has changed.  The caller writes the free map back, in
+//	the same transaction (cf. Put).
+//----------------------------------------------------------------------
+
+void
+InodeTable::Sync()
+{
+    lock->Acquire();
+    for (int i = 0; i < MaxInodes; i++) {
+	if (inodes[i].sector == -1)
+	    continue;
+	inodes[i].lock->AcquireWLock();
+	inodes[i].FlushTail();
+	if (inodes[i].dirty) {
+	    inodes[i].hdr.WriteBack(inodes[i].sector);
+	    inodes[i].dirty = FALSE;
+	}
+	inodes[i].lock->ReleaseLock();
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Inode::FlushTail
+// 	Write the buffered tail block to its sector, if there is one,
+//	and forget it.  The caller holds the inode lock alone, is the
+//	last user of the inode, or is halting Nachos.
+//----------------------------------------------------------------------
+
+void
+Inode::FlushTail()
+{
+    if (tailBlock == -1)
+	return;
+    synchDisk->WriteSector(hdr.ByteToSector(tailBlock * SectorSize), tail);
+    tailBlock = -1;
+}
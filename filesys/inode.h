@@ -0,0 +1,73 @@
+// inode.h
+//	Data structures for the in-core inode table -- the single copy
+//	in memory of the file header of every open file.
+//
+//	Every OpenFile on the same file shares one Inode, so a write
+//	that grows the file through one OpenFile is seen at once by all
+//	the others.  A changed header is only marked dirty; it is written
+//	back to disk when the last OpenFile on the file is closed, or when
+//	the table is synced.
+//
+//	Each inode has a reader/writer lock.  Reads of the file share it,
+//	and so do writes that only overwrite whole blocks the file already
+//	has; anything that changes the header (growing the file, moving
+//	an inline file out of its header) or the tail buffer below holds
+//	it alone.  So any number of threads can read a file at once, and
+//	writers to different files never wait for each other.
+//
+//	Each inode also buffers the last block of the file touched by a
+//	small write (cf. OpenFile::WriteAt), so that a run of small writes
+//	to the same block, such as appends of a few bytes at a time, only
+//	reaches the disk once, when the buffer moves on to another block.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef INODE_H
+#define INODE_H
+
+#include "copyright.h"
+#include "filehdr.h"
+#include "synch.h"
+
+#define MaxInodes 	32	// files that can be open at once
+
+// The following class defines the in-core copy of one file header.
+
+class Inode {
+  public:
+    int sector;			// disk sector of the header, -1 if unused
+    int refCount;		// OpenFiles using this inode
+    bool dirty;			// has hdr changed since it was read?
+    FileHeader hdr;		// the header itself
+    RWLock *lock;		// shared by readers; held alone while
+				// the header or "tail" changes
+    int tailBlock;		// file block buffered in "tail", which
+				// is newer than the disk; -1 if none
+    char tail[SectorSize];
+
+    void FlushTail();		// Write "tail" out, and empty it
+};
+
+// The following class defines the table of in-core inodes.
+
+class InodeTable {
+  public:
+    InodeTable();
+    ~InodeTable();			// Sync, then de-allocate
+
+    Inode *Get(int sector);		// Return the inode whose header is
+					// at "sector", reading it in if
+					// nobody has it open yet
+    void Put(Inode *inode);		// Drop a reference; the last one
+					// writes the header back if dirty
+    void Sync();			// Write back every dirty header
+
+  private:
+    Inode inodes[MaxInodes];
+    Lock *lock;				// protects the table; taken
+					// before any inode's lock
+};
+
+#endif // INODE_H
@@ -0,0 +1,577 @@
+// journal.cc
+//	Routines to log file system metadata before it is written in
+//	place, and to recover from the log.  See journal.h.
+//
+//	A sector belongs in the running group if it is written by a
+//	thread in a transaction, or if an older copy of it is in a group,
+//	or in the log: recovery copies every logged sector home, so a
+//	later write of the same sector that went straight home would be
+//	undone by it.  That way data blocks are only logged in the rare
+//	case that a sector logged as metadata is freed, and reused for
+//	data, before the log starts over.
+//
+//	The log is written with requests that bypass the cache, and each
+//	group's commit sector only after the rest of the group is on
+//	disk.  The committed sectors are then put in the cache, to go
+//	home the usual way.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+#define JournalMagic 	0x4a524e4c	// marks the journal header,
+#define DescriptorMagic 0x44455343	// a descriptor sector,
+#define CommitMagic 	0x434d4954	// and a commit sector
+
+#define LogStart 	(JournalStart + 1)	// first sector of the log
+#define LogSize 	(JournalSectors - 1)	// and how many there are
+#define IntsPerSector 	(SectorSize / (int) sizeof(int))
+
+// Descriptor sectors needed by a group of "count" sectors: a descriptor
+// is the magic number, the group number, the count, and then where each
+// sector belongs.
+
+#define DescriptorSectors(count) ((3 + (count) + IntsPerSector - 1) / IntsPerSector)
+
+//----------------------------------------------------------------------
+// JournalCommitTimeout, JournalCommitDaemon
+// 	The commit timer interrupt handler, and the committer thread.
+//	Need these to be C routines, because C++ can't handle pointers to
+//	member functions.
+//----------------------------------------------------------------------
+
+static void
+JournalCommitTimeout(int arg)
+{
+    ((Journal *) arg)->CommitTimeout();
+}
+
+static void
+JournalCommitDaemon(int arg)
+{
+    ((Journal *) arg)->CommitDaemon();
+}
+
+//----------------------------------------------------------------------
+// JournalGroup::Find
+// 	Return where "sector" is in the group, or -1 if it is not.
+//----------------------------------------------------------------------
+
+int
+JournalGroup::Find(int sector)
+{
+    for (int i = 0; i < count; i++)
+	if (sectors[i] == sector)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal.  It does nothing until the file system
+//	either formats the disk or recovers it.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    enabled = FALSE;
+    lock = new Lock("journal lock");
+    changed = new Condition("journal changed");
+    running = new JournalGroup;
+    committing = new JournalGroup;
+    running->count = committing->count = 0;
+    closed = committingNow = FALSE;
+    numActive = 0;
+    logged = new BitMap(NumSectors);
+    position = 0;
+    nextSeq = 1;
+    commitNeeded = new Semaphore("journal commit", 0);
+    committerForked = FALSE;
+    timerPending = FALSE;
+}
+
+Journal::~Journal()
+{
+    delete lock;
+    delete changed;
+    delete running;
+    delete committing;
+    delete logged;
+    delete commitNeeded;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	The disk is being formatted: start an empty log.  Groups are
+//	numbered on from the ones of any journal the disk had before, so
+//	that none of those can be taken for a new one.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    int header[IntsPerSector];
+
+    ReadLog(JournalStart, (char *) header);
+    nextSeq = 1;
+    if (header[0] == JournalMagic)
+	nextSeq = header[1] + JournalSectors;	// more than the log could
+						// have held since
+    WriteHeader(nextSeq);
+    position = 0;
+    enabled = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	The file system is being mounted.  Copy every group committed in
+//	the log to its home, in order, stopping at the first one that was
+//	not completely written; then make sure they are all on disk, and
+//	start the log over.
+//
+//	A disk formatted without a journal is left without one.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    int header[IntsPerSector], commit[IntsPerSector];
+    int desc[DescriptorSectors(JournalGroupSize) * IntsPerSector];
+    char data[SectorSize];
+    int groups = 0;
+
+    ReadLog(JournalStart, (char *) header);
+    if (header[0] != JournalMagic) {
+	DEBUG('f', "No journal on this disk; format it to have one\n");
+	return;
+    }
+    nextSeq = header[1];
+    position = 0;
+    for (;;) {
+	int count, numDesc;
+
+	if (position + 2 > LogSize)
+	    break;
+	ReadLog(LogStart + position, (char *) desc);
+	if (desc[0] != DescriptorMagic || desc[1] != nextSeq
+			|| desc[2] < 1 || desc[2] > JournalGroupSize)
+	    break;
+	count = desc[2];
+	numDesc = DescriptorSectors(count);
+	if (position + numDesc + count + 1 > LogSize)
+	    break;
+	for (int i = 1; i < numDesc; i++)
+	    ReadLog(LogStart + position + i, (char *) (desc + i * IntsPerSector));
+	ReadLog(LogStart + position + numDesc + count, (char *) commit);
+	if (commit[0] != CommitMagic || commit[1] != nextSeq
+			|| commit[2] != count)
+	    break;			// not committed
+
+	DEBUG('f', "Replaying journal group %d, %d sectors\n", nextSeq, count);
+	for (int i = 0; i < count; i++) {
+	    int sector = desc[3 + i];
+
+	    if (sector < 0 || sector >= NumSectors)
+		continue;
+	    ReadLog(LogStart + position + numDesc + i, data);
+	    synchDisk->WriteSector(sector, data);
+	    stats->numJournalReplayed++;
+	}
+	position += numDesc + count + 1;
+	nextSeq++;
+	groups++;
+    }
+    if (groups > 0)
+	printf("Journal: replayed %d committed groups\n", groups);
+    Checkpoint();
+    enabled = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Shutdown
+// 	Nachos is halting.  Commit the last transactions, get everything
+//	home, and empty the log, so that nothing written from now on can
+//	be undone by recovery.
+//
+//	If a transaction never ended, leave the log as it is: the next
+//	mount goes back to the last group committed.
+//----------------------------------------------------------------------
+
+void
+Journal::Shutdown()
+{
+    if (!enabled)
+	return;
+    if (numActive > 0) {
+	DEBUG('f', "Halting inside a transaction; journal left to recover\n");
+	enabled = FALSE;
+	return;
+    }
+    Commit();
+    enabled = FALSE;
+    Checkpoint();
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction in the current thread: from now until End,
+//	every sector it writes goes into the running group.  A thread
+//	already in a transaction just goes deeper into it.
+//
+//	Wait while the running group is being closed for commit, while
+//	it is full and the previous one is still being written, and
+//	while it has no room left for one more transaction; in that case
+//	have it committed.  The caller must not hold any lock a
+//	transaction might need.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    int i;
+
+    if (!enabled)
+	return;
+    lock->Acquire();
+    if ((i = Holder(currentThread)) != -1)
+	depth[i]++;
+    else {
+	while (closed
+		|| (committingNow && running->count >= JournalCommitSize)
+		|| running->count + (numActive + 1) * JournalReserve
+							> JournalGroupSize) {
+	    if (!closed && running->count > 0)
+		commitNeeded->V();
+	    changed->Wait(lock);
+	}
+	ASSERT(numActive < MaxTransactions);
+	holders[numActive] = currentThread;
+	depth[numActive++] = 1;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	End the current thread's transaction.  Its sectors are committed
+//	with the rest of the running group; if that group is big enough,
+//	have it committed now.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    int i;
+
+    if (!enabled)
+	return;
+    lock->Acquire();
+    i = Holder(currentThread);
+    ASSERT(i != -1);
+    if (--depth[i] == 0) {
+	holders[i] = holders[--numActive];
+	depth[i] = depth[numActive];
+	changed->Broadcast(lock);	// room for one more, or none left
+	if (running->count >= JournalCommitSize && !closed)
+	    commitNeeded->V();
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Commit the running group, and return when it is in the log.
+//	Close the group to new transactions, wait for the ones in it to
+//	end, and then write it out while the next group fills.  Commits
+//	are done one at a time.  The caller must not be in a transaction.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    JournalGroup *group;
+
+    lock->Acquire();
+    ASSERT(Holder(currentThread) == -1);
+    while (committingNow)
+	changed->Wait(lock);
+    if (!enabled || running->count == 0) {
+	lock->Release();
+	return;
+    }
+    committingNow = closed = TRUE;
+    while (numActive > 0)
+	changed->Wait(lock);
+    group = running;
+    running = committing;		// empty
+    committing = group;
+    closed = FALSE;
+    changed->Broadcast(lock);
+    lock->Release();
+
+    WriteGroup(committing);
+    for (int i = 0; i < committing->count; i++)
+	synchDisk->Install(committing->sectors[i], committing->data[i]);
+
+    lock->Acquire();
+    for (int i = 0; i < committing->count; i++)
+	logged->Mark(committing->sectors[i]);
+    committing->count = 0;
+    committingNow = FALSE;
+    changed->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Absorb
+// 	"sector" is being written with "data".  If it belongs in the
+//	running group, put it there, in place of any older copy, and
+//	return TRUE; the caller must not write it anywhere else.  Return
+//	FALSE if it should be written as usual.
+//
+//	Begin keeps room in the running group for every transaction in
+//	it, so it can only fill up if one writes more than JournalReserve
+//	sectors.  The sector is then written as usual, which loses the
+//	atomicity of that transaction; this is a bug, and is reported.
+//----------------------------------------------------------------------
+
+bool
+Journal::Absorb(int sector, char *data)
+{
+    int i;
+
+    if (!enabled)
+	return FALSE;
+    lock->Acquire();
+    if ((i = running->Find(sector)) == -1) {
+	if (Holder(currentThread) == -1 && !logged->Test(sector)
+			&& committing->Find(sector) == -1) {
+	    lock->Release();
+	    return FALSE;
+	}
+	if (running->count == JournalGroupSize) {
+	    printf("Journal group full; sector %d written in place\n",
+								sector);
+	    stats->numJournalOverflows++;
+	    lock->Release();
+	    return FALSE;
+	}
+	i = running->count++;
+	running->sectors[i] = sector;
+	if (i == 0)
+	    StartCommitTimer();
+    }
+    bcopy(data, running->data[i], SectorSize);
+    stats->numJournalWrites++;
+    lock->Release();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Lookup
+// 	If "sector" was written into the journal and has not yet been
+//	put in the cache, copy the newest contents into "data", and
+//	return TRUE.
+//----------------------------------------------------------------------
+
+bool
+Journal::Lookup(int sector, char *data)
+{
+    int i;
+
+    if (!enabled)
+	return FALSE;
+    lock->Acquire();
+    if ((i = running->Find(sector)) != -1)
+	bcopy(running->data[i], data, SectorSize);
+    else if ((i = committing->Find(sector)) != -1)
+	bcopy(committing->data[i], data, SectorSize);
+    lock->Release();
+    return (i != -1);
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitDaemon
+// 	Body of the committer thread: commit the running group each time
+//	the commit timer goes off, or the group gets big.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitDaemon()
+{
+    for (;;) {
+	commitNeeded->P();
+	Commit();
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitTimeout
+// 	Commit timer interrupt handler.  Can't do disk I/O here, so just
+//	wake up the committer thread.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitTimeout()
+{
+    timerPending = FALSE;
+    commitNeeded->V();
+}
+
+//----------------------------------------------------------------------
+// Journal::StartCommitTimer
+// 	The running group has just got its first sector.  Make sure it
+//	is committed within CommitInterval ticks.  As with the flush
+//	timer, the timer only runs while there is something to commit,
+//	so that an idle machine can still halt.  The caller holds the
+//	lock.
+//----------------------------------------------------------------------
+
+void
+Journal::StartCommitTimer()
+{
+    if (timerPending)
+	return;
+    if (!committerForked) {
+	Thread *t = new Thread("journal committer");
+
+	committerForked = TRUE;
+	t->Fork(JournalCommitDaemon, (int) this);
+    }
+    timerPending = TRUE;
+    interrupt->Schedule(JournalCommitTimeout, (int) this, CommitInterval,
+								TimerInt);
+}
+
+//----------------------------------------------------------------------
+// Journal::Holder
+// 	Return where "thread" is in the list of threads in a transaction,
+//	or -1 if it is not in one.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+int
+Journal::Holder(Thread *thread)
+{
+    for (int i = 0; i < numActive; i++)
+	if (holders[i] == thread)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteGroup
+// 	Append "group" to the log, starting the log over first if it
+//	would not fit.  The descriptors and the sectors are queued at
+//	once, so that they go out as one sequential run; the commit
+//	sector follows when they are all on disk.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteGroup(JournalGroup *group)
+{
+    int count = group->count;
+    int numDesc = DescriptorSectors(count);
+    int desc[DescriptorSectors(JournalGroupSize) * IntsPerSector];
+    int commit[IntsPerSector];
+    DiskRequest *batch[DescriptorSectors(JournalGroupSize) + JournalGroupSize];
+
+    if (position + numDesc + count + 1 > LogSize)
+	Checkpoint();
+    DEBUG('f', "Committing journal group %d, %d sectors, at %d\n", nextSeq,
+							count, position);
+
+    bzero((char *) desc, sizeof(desc));
+    desc[0] = DescriptorMagic;
+    desc[1] = nextSeq;
+    desc[2] = count;
+    for (int i = 0; i < count; i++)
+	desc[3 + i] = group->sectors[i];
+    for (int i = 0; i < numDesc; i++)
+	batch[i] = new DiskRequest(LogStart + position + i,
+			(char *) (desc + i * IntsPerSector), TRUE);
+    for (int i = 0; i < count; i++)
+	batch[numDesc + i] = new DiskRequest(LogStart + position + numDesc + i,
+			group->data[i], TRUE);
+    for (int i = 0; i < numDesc + count; i++)
+	synchDisk->Start(batch[i]);
+    for (int i = 0; i < numDesc + count; i++) {
+	batch[i]->Wait();
+	delete batch[i];
+    }
+
+    bzero((char *) commit, sizeof(commit));
+    commit[0] = CommitMagic;
+    commit[1] = nextSeq;
+    commit[2] = count;
+    WriteLog(LogStart + position + numDesc + count, (char *) commit);
+
+    position += numDesc + count + 1;
+    nextSeq++;
+    stats->numJournalCommits++;
+    stats->numJournalSectors += count;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Make sure every group in the log is at home on disk, and then
+//	start the log over, with the next group.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    DEBUG('f', "Journal checkpoint, at group %d\n", nextSeq);
+    synchDisk->Sync();
+    WriteHeader(nextSeq);
+    position = 0;
+    lock->Acquire();
+    delete logged;
+    logged = new BitMap(NumSectors);
+    lock->Release();
+    stats->numJournalCheckpoints++;
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the journal header, saying that the log starts with group
+//	"firstSeq".
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader(int firstSeq)
+{
+    int header[IntsPerSector];
+
+    bzero((char *) header, sizeof(header));
+    header[0] = JournalMagic;
+    header[1] = firstSeq;
+    WriteLog(JournalStart, (char *) header);
+}
+
+//----------------------------------------------------------------------
+// Journal::ReadLog/WriteLog
+// 	Transfer a sector of the journal straight between "data" and the
+//	disk, and wait for it.
+//----------------------------------------------------------------------
+
+void
+Journal::ReadLog(int sector, char *data)
+{
+    DiskRequest request(sector, data, FALSE);
+
+    synchDisk->Start(&request);
+    request.Wait();
+}
+
+void
+Journal::WriteLog(int sector, char *data)
+{
+    DiskRequest request(sector, data, TRUE);
+
+    synchDisk->Start(&request);
+    request.Wait();
+}
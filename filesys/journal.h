@@ -0,0 +1,139 @@
+// journal.h
+//	Data structures for the write-ahead journal of file system
+//	metadata.
+//
+//	Without a journal, an operation such as Create writes a file
+//	header, a directory and the free map separately, and a crash in
+//	between leaves them disagreeing.  With one, each operation is a
+//	transaction: the sectors it writes are held in memory, in the
+//	"running group", and reach their home on disk only after the
+//	whole group has been written, in order, to a log region near the
+//	start of the disk, and marked committed there.  At mount, any
+//	committed group that may not have reached home is copied there
+//	again from the log, so every operation is either all on disk or
+//	not at all.
+//
+//	Group commit: transactions are not committed one by one.  A
+//	committer thread writes the running group out when it has
+//	JournalCommitSize sectors, when it is CommitInterval ticks old,
+//	or when Nachos halts, so that a sector written by many
+//	operations in a row (a directory, say) is logged once.  While a
+//	group is written, new transactions go on in the next one.  A
+//	transaction only starts if the running group has room for it,
+//	and for the others still in it, to write JournalReserve sectors
+//	each; otherwise it waits for the group to be committed.
+//
+//	The log is a circular region of JournalSectors sectors.  Before
+//	it wraps around, a checkpoint writes the cache out, so that the
+//	groups in the log are all at home, and starts the log over.
+//
+//	On disk, the region starts with a header sector; each committed
+//	group is then one or more descriptor sectors, listing where the
+//	group's sectors belong, the sectors themselves, and a commit
+//	sector.  Groups are numbered, so that recovery stops at the first
+//	one not written completely, or left over from before the log
+//	last started over.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "bitmap.h"
+#include "synch.h"
+
+#define JournalStart 	  2	// sector of the journal header; the log
+				// follows it
+#define JournalSectors 	  512	// sectors in the journal, header included
+#define JournalGroupSize  128	// most sectors a group can hold
+#define JournalCommitSize 32	// a group this big is committed at once
+#define JournalReserve 	  16	// most sectors one transaction writes;
+				// room for this many is kept in the
+				// running group for each one
+#define CommitInterval 	  20000	// most ticks a transaction waits to be
+				// committed
+#define MaxTransactions   32	// threads in a transaction at once
+
+// The following class defines a group of sectors written by
+// transactions, and the newest contents of each.
+
+class JournalGroup {
+  public:
+    int count;				// sectors in the group
+    int sectors[JournalGroupSize];	// where each one belongs
+    char data[JournalGroupSize][SectorSize];
+
+    int Find(int sector);		// Index of "sector", or -1
+};
+
+// The following class defines the journal.  It is used through
+// SynchDisk, which offers it every sector written, and asks it first
+// for every sector read.
+
+class Journal {
+  public:
+    Journal();
+    ~Journal();
+
+    void Format();			// Start an empty log on a new disk
+    void Recover();			// Mount: replay the committed groups
+    					// and start the log over
+    void Shutdown();			// Halt: commit, checkpoint, and stop
+					// journaling
+
+    void Begin();			// Start a transaction, in the
+					// current thread
+    void End();				// End it; it is committed later
+    void Commit();			// Commit what has been done so far,
+					// and wait for it
+
+    bool Absorb(int sector, char *data);
+					// Keep a written sector in the
+					// running group, if it belongs there
+    bool Lookup(int sector, char *data);
+					// Return a sector written but not
+					// yet at home, if there is one
+
+    void CommitDaemon();		// Body of the committer thread
+    void CommitTimeout();		// Called by the commit timer interrupt
+
+  private:
+    bool enabled;			// is there a log on this disk?
+    Lock *lock;				// protects everything below
+    Condition *changed;			// a group closed or opened, or a
+					// transaction ended
+    JournalGroup *running;		// group transactions write into
+    JournalGroup *committing;		// group being written to the log
+    bool closed;			// is "running" about to be committed?
+    bool committingNow;			// is a commit under way?
+
+    Thread *holders[MaxTransactions];	// threads in a transaction,
+    int depth[MaxTransactions];		// and how deeply nested
+    int numActive;			// number of them
+
+    BitMap *logged;			// sectors in the log since it last
+					// started over
+    int position;			// where the next group goes in the log
+    int nextSeq;			// number of the next group
+    Semaphore *commitNeeded;		// the committer thread waits here
+    bool committerForked;		// Has the committer thread started?
+    bool timerPending;			// Is the commit timer running?
+
+    int Holder(Thread *thread);		// Index of "thread" in "holders"
+    void StartCommitTimer();		// The running group just got its
+					// first sector
+    void WriteGroup(JournalGroup *group);
+					// Write a group to the log
+    void Checkpoint();			// Get the log's groups home, and
+					// start the log over
+    void WriteHeader(int firstSeq);
+    void ReadLog(int sector, char *data);
+    void WriteLog(int sector, char *data);
+					// Go straight to the disk
+};
+
+#endif // JOURNAL_H
@@ -4,8 +4,9 @@
 //	Once we're all done, we can close it (in Nachos, by deleting
 //	the OpenFile data structure).
 //
-//	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	Also as in UNIX, we keep the file header in memory while the file
+//	is open.  There is only one in-memory copy of each header, shared
+//	by all the OpenFiles on that file (cf. inode.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -13,6 +14,7 @@
 
 #include "copyright.h"
 #include "filehdr.h"
+#include "inode.h"
 #include "openfile.h"
 #include "system.h"
 #include "directory.h"
@@ -21,12 +23,13 @@
 
 #endif
 #include <stdio.h>
+#include <time.h>
 #define NumDirEntries       10
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it is there already.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
@@ -34,22 +37,47 @@
 OpenFile::OpenFile(int sector)
 { 
     hdrSector = sector;
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    inode = inodeTable->Get(sector);
+    hdr = &inode->hdr;
     //printf("in openfile::openfile, hdr set successfully\n");
    // printf("in OpenFile::OpenFile, the sector number is %d and situation is \n", hdr->getSector());
     //hdr->PrintSectors();
     seekPosition = 0;
+    nextReadPos = 0;
+    readAheadTo = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	The header goes back to disk when the last OpenFile on the file
+//	is closed.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    inodeTable->Put(inode);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Flush
+// 	Write the file's buffered tail block, and its header if it
+//	changed, to disk now instead of when the file is closed.  Used
+//	for metadata files, which stay open, so that their writes go
+//	into the caller's transaction.  If the header changed, so did the
+//	free map, which the caller must write in the same transaction.
+//----------------------------------------------------------------------
+
+void
+OpenFile::Flush()
+{
+    inode->lock->AcquireWLock();
+    inode->FlushTail();
+    if (inode->dirty) {
+        hdr->WriteBack(hdrSector);
+        inode->dirty = FALSE;
+    }
+    inode->lock->ReleaseLock();
 }
 
 //----------------------------------------------------------------------
@@ -96,6 +124,23 @@ OpenFile::Write(char *into, int numBytes)
    return result;
 }
 
+//----------------------------------------------------------------------
+// SectorSpan
+// 	Return in "start" and "end" the part of file block "block" that
+//	a transfer of "numBytes" at "position" covers, as file offsets.
+//----------------------------------------------------------------------
+
+static void
+SectorSpan(int block, int position, int numBytes, int *start, int *end)
+{
+    *start = block * SectorSize;
+    *end = *start + SectorSize;
+    if (*start < position)
+        *start = position;
+    if (*end > position + numBytes)
+        *end = position + numBytes;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::ReadAt/WriteAt
 // 	Read/write a portion of a file, starting at "position".
@@ -107,13 +152,29 @@ OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   Sectors wholly inside the request are read straight into the
+//	   caller's buffer.  A sector at either end that is only partly
+//	   wanted is read into a one-sector buffer on the stack, and only
+//	   the part we are interested in is copied.  When a read starts
+//	   where the last one through this OpenFile ended, the next
+//	   ReadAheadSectors blocks are prefetched into the sector cache,
+//	   so a sequential reader seldom waits for the disk.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   Sectors wholly inside the request are written straight from the
+//	   caller's buffer.  A sector at either end that is only partly
+//	   written must first be read in, so that we don't overwrite the
+//	   unmodified portion; we copy in the data that will be modified,
+//	   and write it back.
+//
+//	   A write of less than a sector, inside one sector, goes into the
+//	   inode's tail buffer instead (cf. inode.h); the sector is only
+//	   read the first time, and only written when the buffer moves on.
+//	   Reads look in the buffer too.
+//
+//	An inline file (cf. DiskFileHeader) is read and written in its
+//	header, in memory, with the inode locked; a write that would take
+//	it past InlineSize bytes first moves it to a data sector, and is
+//	then done as for any other file.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -125,38 +186,64 @@ OpenFile::Write(char *into, int numBytes)
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
-
-    if ((numBytes <= 0) || (position >= fileLength))
+    int fileLength;
+    int i, firstSector, lastSector, start, end;
+    char bounce[SectorSize];		// for a partly wanted sector
+
+    inode->lock->AcquireRLock();
+    fileLength = hdr->FileLength();
+    if ((numBytes <= 0) || (position >= fileLength)) {
+        inode->lock->ReleaseLock();
     	return 0; 				// check request
+    }
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
+    if (hdr->IsInline()) {
+        hdr->ReadInline(into, numBytes, position);
+        inode->lock->ReleaseLock();
+        return numBytes;
+    }
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
-    //printf("in readAt, before buf new, numSectors is %d and SectorSize is %d, numSectors*SectorSize is %d\n", 
-    //    numSectors, SectorSize, numSectors * SectorSize);
-   
-    buf = new char[numSectors * SectorSize];
-
-    for (i = firstSector; i <= lastSector; i++)	
-    {
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-                    &buf[(i - firstSector) * SectorSize]);   
+    // whole sectors go straight into "into"; only the ends bounce
+    for (i = firstSector; i <= lastSector; i++) {
+        SectorSpan(i, position, numBytes, &start, &end);
+        if (end - start == SectorSize)
+            synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize),
+                        &into[start - position]);
+        else {
+            synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), bounce);
+            bcopy(&bounce[start - i * SectorSize], &into[start - position],
+                        end - start);
+        }
     }
-        
 
+    // a block still in the tail buffer is newer than on disk
+    i = inode->tailBlock;
+    if (i != -1 && i >= firstSector && i <= lastSector) {
+        SectorSpan(i, position, numBytes, &start, &end);
+        bcopy(&inode->tail[start - i * SectorSize], &into[start - position],
+                    end - start);
+    }
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    // sequential so far: start reading the next blocks
+    if (position == nextReadPos) {
+        int last = lastSector + ReadAheadSectors;
+
+        if (last > divRoundUp(fileLength, SectorSize) - 1)
+            last = divRoundUp(fileLength, SectorSize) - 1;
+        for (i = (readAheadTo > lastSector) ? readAheadTo : lastSector + 1;
+                i <= last; i++)
+            synchDisk->Prefetch(hdr->ByteToSector(i * SectorSize));
+        if (last + 1 > readAheadTo)
+            readAheadTo = last + 1;
+    } else
+        readAheadTo = lastSector + 1;	// start over from here
+    nextReadPos = position + numBytes;
+    inode->lock->ReleaseLock();
     return numBytes;
 }
 
@@ -165,67 +252,133 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 {
    
     //fileSystem->List();
-    int fileLength = hdr->FileLength();
-    int prevSecNum = divRoundUp(fileLength, SectorSize);
+    int fileLength;
+    int prevSecNum;
 
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int i, firstSector, lastSector, numSectors, start, end;
+    bool small, exclusive;
+    char bounce[SectorSize];		// for a partly written sector
+    int now = (int) time(NULL);
 
     if (numBytes <= 0)
 	return 0;				// check request
+    firstSector = divRoundDown(position, SectorSize);
+    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
+    numSectors = 1 + lastSector - firstSector;
+    small = (numSectors == 1 && numBytes < SectorSize);
+
+// Overwriting whole blocks the file already has changes nothing else,
+// so such writes share the inode lock with readers.  Any other write
+// holds it alone: it changes the header or the tail buffer, or it
+// reads a block in and writes it back, and two of those on the same
+// block would lose one's bytes.  The first write in each second also
+// stamps the header's modification time.  A file never gets shorter,
+// nor back into its header, so only the tail buffer and that time can
+// change before the lock is taken.
+    exclusive = (position % SectorSize != 0)
+                || ((position + numBytes) % SectorSize != 0)
+                || hdr->IsInline() || position + numBytes > hdr->FileLength()
+                || hdr->ModifiedTime() != now;
+    if (!exclusive) {
+        inode->lock->AcquireRLock();
+        if ((inode->tailBlock >= firstSector && inode->tailBlock <= lastSector)
+                || hdr->ModifiedTime() != now) {
+            inode->lock->ReleaseLock();	// changed meanwhile
+            exclusive = TRUE;
+        }
+    }
+    if (exclusive)
+        inode->lock->AcquireWLock();
+    fileLength = hdr->FileLength();
+
+    if (hdr->IsInline()) {
+        if (position + numBytes <= InlineSize) {
+            hdr->WriteInline(from, numBytes, position);
+            hdr->Touch(now);
+            inode->dirty = TRUE;
+            inode->lock->ReleaseLock();
+            return numBytes;
+        }
+        // outgrown; give it a block
+        bool success = hdr->Uninline(fileSystem->AcquireFreeMap(),
+                        inode->sector + 1);
+
+        fileSystem->ReleaseFreeMap();
+        if (!success) {
+            inode->lock->ReleaseLock();
+            return -1;
+        }
+        inode->dirty = TRUE;
+    }
+
+// The header is only marked dirty, and goes back to disk when the file
+// is closed.
+    prevSecNum = divRoundUp(fileLength, SectorSize);
     if ((position + numBytes) > prevSecNum * SectorSize)             //have to enlarge the file
     {        
-        printf("the file has to be enlarged in OpenFile::WriteAt\n");
+        DEBUG('f', "Enlarging the file at sector %d\n", hdrSector);
         //int neededBytes = position + numBytes - fileLength;
         int neededBytes = position + numBytes - prevSecNum * SectorSize;
         ASSERT(neededBytes > 0);
-        BitMap *freeMap = new BitMap(NumSectors);
-        OpenFile *freeMapFile = new OpenFile(0);                    //open freemap file
-        freeMap->FetchFrom(freeMapFile);
-        bool success = hdr->EnlargeFile(freeMap, neededBytes);
+        bool success = hdr->EnlargeFile(fileSystem->AcquireFreeMap(), neededBytes);
+        fileSystem->ReleaseFreeMap();
         if(!success)
         {
             printf("file length enlarge has failed\n");
+            inode->lock->ReleaseLock();
             return -1;
         }
-        freeMap->WriteBack(freeMapFile);
-        hdr->WriteBack(hdrSector);
-
-
+        inode->dirty = TRUE;
     }
     else if(position + numBytes > fileLength)
     {
         hdr->ChangeFileLength(position + numBytes);
-        hdr->WriteBack(hdrSector);   
+        inode->dirty = TRUE;
     }
+    if (hdr->Touch(now))
+        inode->dirty = TRUE;
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+// a small write only changes the tail buffer; the block is read in
+// unless it is past the old end of the file
+    if (small) {
+        if (inode->tailBlock == firstSector)
+            stats->numWritesMerged++;
+        else {
+            inode->FlushTail();
+            if (firstSector * SectorSize < fileLength)
+                synchDisk->ReadSector(hdr->ByteToSector(firstSector * SectorSize),
+                                inode->tail);
+            else
+                bzero(inode->tail, SectorSize);
+            inode->tailBlock = firstSector;
+        }
+        bcopy(from, &inode->tail[position - firstSector * SectorSize], numBytes);
+        inode->lock->ReleaseLock();
+        return numBytes;
+    }
+    if (inode->tailBlock >= firstSector && inode->tailBlock <= lastSector)
+        inode->FlushTail();		// about to be overwritten
+
+// whole sectors come straight from "from"; a sector only partly
+// written is read in first, unless it is past the old end of the file
+    for (i = firstSector; i <= lastSector; i++) {
+        SectorSpan(i, position, numBytes, &start, &end);
+        if (end - start == SectorSize) {
+            synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize),
+                        &from[start - position]);
+            continue;
+        }
+        if (i * SectorSize < fileLength)
+            synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), bounce);
+        else
+            bzero(bounce, SectorSize);
+        bcopy(&from[start - position], &bounce[start - i * SectorSize],
+                        end - start);
+        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), bounce);
+    }
+    inode->lock->ReleaseLock();
     return numBytes;
 }
 
@@ -239,3 +392,15 @@ OpenFile::Length()
 { 
     return hdr->FileLength(); 
 }
+
+//----------------------------------------------------------------------
+// OpenFile::ModifiedTime
+// 	Return when the file's data last changed, in seconds since the
+//	epoch.
+//----------------------------------------------------------------------
+
+int
+OpenFile::ModifiedTime()
+{
+    return hdr->ModifiedTime();
+}
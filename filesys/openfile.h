@@ -63,6 +63,10 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class Inode;
+
+#define ReadAheadSectors 	4	// how far ahead of a sequential
+					// reader to prefetch
 
 class OpenFile {
   public:
@@ -88,13 +92,21 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    int ModifiedTime();			// When the data last changed
+    void Flush();			// Write out what is buffered in
+					// memory: the tail block and the
+					// header, if changed
     int getHdrSector(){return hdrSector;}
 
     
   private:
     int hdrSector;
-    FileHeader *hdr;			// Header for this file 
+    Inode *inode;			// In-core inode, shared by every
+					// OpenFile on this file
+    FileHeader *hdr;			// Header for this file, in "inode"
     int seekPosition;			// Current position within the file
+    int nextReadPos;			// Where a sequential read would start
+    int readAheadTo;			// First file block not yet prefetched
 };
 
 #endif // FILESYS
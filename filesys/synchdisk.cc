@@ -5,10 +5,28 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request carries a semaphore, to synchronize the interrupt
+//	handler with the thread waiting for it.  The physical disk can
+//	only handle one operation at a time, so requests wait their turn
+//	in a DiskQueue; since several requests can be waiting, the queue
+//	can reorder them to cut down on seeks.
+//
+//	Start gives the kernel the asynchronous side of this: it queues a
+//	request and returns, and the caller waits for it later, or has a
+//	handler called.  The prefetcher and the flusher use the queue the
+//	same way, starting a whole batch of requests before waiting.
+//
+//	A lock protects the sector cache.  A cache hit costs no simulated
+//	disk time at all; a miss evicts the least recently used sector,
+//	writing it out first if it is dirty.  The lock is let go while
+//	waiting for the disk, so that other threads can use the cache, or
+//	queue requests of their own; an entry being read in is marked busy
+//	until the data is there.
+//
+//	With a journal (cf. journal.h), every sector written is offered to
+//	it first, and every sector read is looked for there first; what
+//	the journal keeps only comes to the cache, through Install, once
+//	it is committed.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,54 +34,98 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
-// DiskRequestDone
-// 	Disk interrupt handler.  Need this to be a C routine, because 
-//	C++ can't handle pointers to member functions.
+// DiskFlushTimeout, DiskFlushDaemon
+// 	The flush timer interrupt handler, and the flusher thread.  Need
+//	these to be C routines, because C++ can't handle pointers to
+//	member functions.
 //----------------------------------------------------------------------
 
 static void
-DiskRequestDone (int arg)
+DiskFlushTimeout (int arg)
 {
-    SynchDisk* disk = (SynchDisk *)arg;
+    ((SynchDisk *)arg)->FlushTimeout();
+}
 
-    disk->RequestDone();
+static void
+DiskFlushDaemon (int arg)
+{
+    ((SynchDisk *)arg)->FlushDaemon();
+}
+
+static void
+DiskPrefetchDaemon (int arg)
+{
+    ((SynchDisk *)arg)->PrefetchDaemon();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
-//	initializing the physical disk.
+//	initializing the physical disk.  The cache starts out empty.
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
-//	   (usually, "DISK")
+//	   (usually, "DISK"); with several disks, the prefix of their names
+//	"cacheSize" -- number of sectors to cache; 0 means no caching
+//	"policy" -- the order to serve waiting requests in
+//	"modelName" -- how long disk requests take (see NewLatencyModel)
+//	"numDisks", "layout" -- how many disks, striped or mirrored
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, int cacheSize, DiskPolicy policy,
+		char *modelName, int numDisks, ArrayLayout layout)
 {
-    semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (int) this);
+    ioDone = new Condition("synch disk io done");
+    disks = new DiskArray(name, numDisks, layout, policy, modelName);
+
+    numEntries = cacheSize;
+    cache = NULL;
+    if (numEntries > 0)
+	cache = new CacheEntry[numEntries];
+    for (int i = 0; i < numEntries; i++) {
+	cache[i].sector = -1;
+	cache[i].dirty = FALSE;
+	cache[i].busy = FALSE;
+	cache[i].lastUsed = 0;
+    }
+    useClock = 0;
+    writesOut = 0;
+    flushNeeded = new Semaphore("disk flush", 0);
+    flusherForked = FALSE;
+    flushPending = FALSE;
+    prefetchHead = prefetchCount = 0;
+    prefetchNeeded = new Semaphore("disk prefetch", 0);
+    prefetcherForked = FALSE;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::~SynchDisk
 // 	De-allocate data structures needed for the synchronous disk
-//	abstraction.
+//	abstraction.  Nachos is halting, so dirty sectors are written
+//	straight to the disk, without waiting for simulated time.
 //----------------------------------------------------------------------
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
+    for (int i = 0; i < numEntries; i++)
+	if (cache[i].dirty)
+	    disks->WriteImmediate(cache[i].sector, cache[i].data);
+    delete [] cache;
+    delete disks;
+    delete ioDone;
     delete lock;
-    delete semaphore;
+    delete flushNeeded;
+    delete prefetchNeeded;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
 // 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+//	after the data has been read.  If the sector is cached, the
+//	disk is not touched.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -72,16 +134,46 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    CacheEntry *entry;
+
+    if (journal != NULL && journal->Lookup(sectorNumber, data))
+	return;				// newer than the disk and the cache
+    if (numEntries == 0) {
+	DiskRead(sectorNumber, data);
+	return;
+    }
+    lock->Acquire();
+    for (;;) {
+	entry = Lookup(sectorNumber);
+	if (entry != NULL && entry->busy) {
+	    ioDone->Wait(lock);		// somebody is reading it in
+	    continue;
+	}
+	if (entry != NULL) {
+	    stats->numCacheHits++;
+	    break;
+	}
+	if ((entry = Allocate(sectorNumber)) == NULL)
+	    continue;			// waited; look again
+	stats->numCacheMisses++;
+	lock->Release();
+	DiskRead(sectorNumber, entry->data);
+	lock->Acquire();
+	entry->busy = FALSE;
+	ioDone->Broadcast(lock);
+	break;
+    }
+    entry->lastUsed = ++useClock;
+    bcopy(entry->data, data, SectorSize);
     lock->Release();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  With the
+//	cache on, only the cached copy is written; the sector reaches
+//	the disk later.  A sector the journal takes is not written here
+//	at all, until the journal has committed it.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -90,21 +182,429 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    //printf("synchdisk writesector done!!!!!!!\n");
-    semaphore->P();			// wait for interrupt
+    if (journal != NULL && journal->Absorb(sectorNumber, data))
+	return;
+    Install(sectorNumber, data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Install
+// 	Write a sector into the cache, or to the disk if the cache is
+//	off, without offering it to the journal.  Used by the journal,
+//	to put committed sectors in place.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Install(int sectorNumber, char* data)
+{
+    CacheEntry *entry;
+
+    if (numEntries == 0) {
+	DiskWrite(sectorNumber, data);
+	return;
+    }
+    lock->Acquire();
+    for (;;) {
+	entry = Lookup(sectorNumber);
+	if (entry != NULL && entry->busy) {
+	    ioDone->Wait(lock);		// let the read in finish first
+	    continue;
+	}
+	if (entry != NULL) {
+	    stats->numCacheHits++;
+	    break;
+	}
+	if ((entry = Allocate(sectorNumber)) == NULL)
+	    continue;			// waited; look again
+	stats->numCacheMisses++;	// the whole sector is overwritten,
+	break;				// so no need to read it first
+    }
+    entry->lastUsed = ++useClock;
+    bcopy(data, entry->data, SectorSize);
+    entry->dirty = TRUE;
+    if (entry->busy) {
+	entry->busy = FALSE;
+	ioDone->Broadcast(lock);
+    }
+    StartFlushTimer();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Start
+// 	Start reading or writing a sector, as described by "request", and
+//	return without waiting for it.  The caller can go on with other
+//	work, and later wait for the request or have its handler called.
+//	Any number of requests can be outstanding at once.
+//
+//	The request goes straight to the disk, but is kept consistent
+//	with the cache: a read of a cached sector is served from the
+//	cache, and is done at once; a write updates the cached copy too.
+//	If the sector is just being read into the cache, wait for that
+//	first.  Likewise, the journal serves the sectors it holds, and
+//	takes the ones written by a transaction.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    CacheEntry *entry;
+    IntStatus oldLevel;
+
+    if (journal != NULL && (request->writing
+		? journal->Absorb(request->sector, request->data)
+		: journal->Lookup(request->sector, request->data))) {
+	oldLevel = interrupt->SetLevel(IntOff);
+	request->Complete();
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
+    if (numEntries == 0) {
+	disks->Submit(request);
+	return;
+    }
+    lock->Acquire();
+    while ((entry = Lookup(request->sector)) != NULL && entry->busy)
+	ioDone->Wait(lock);
+    if (entry != NULL && !request->writing) {
+	stats->numCacheHits++;
+	entry->lastUsed = ++useClock;
+	bcopy(entry->data, request->data, SectorSize);
+	lock->Release();
+	oldLevel = interrupt->SetLevel(IntOff);
+	request->Complete();
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
+    if (entry != NULL)
+	bcopy(request->data, entry->data, SectorSize);
+    disks->Submit(request);		// before anybody else can write it
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Queue "sectorNumber" to be read into the cache by the prefetcher
+//	thread, and return at once.  This is only a hint: it is dropped
+//	if the cache is off, the sector is already cached or queued, or
+//	the queue is full.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Prefetch(int sectorNumber)
+{
+    if (numEntries == 0)
+	return;
+    lock->Acquire();
+    if (Lookup(sectorNumber) == NULL && prefetchCount < PrefetchQueueSize) {
+	for (int i = 0; i < prefetchCount; i++)
+	    if (prefetchQueue[(prefetchHead + i) % PrefetchQueueSize]
+							== sectorNumber) {
+		lock->Release();
+		return;
+	    }
+	if (!prefetcherForked) {
+	    Thread *t = new Thread("disk prefetcher");
+
+	    prefetcherForked = TRUE;
+	    t->Fork(DiskPrefetchDaemon, (int) this);
+	}
+	prefetchQueue[(prefetchHead + prefetchCount) % PrefetchQueueSize]
+							= sectorNumber;
+	prefetchCount++;
+	prefetchNeeded->V();
+    }
     lock->Release();
 }
 
 //----------------------------------------------------------------------
-// SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// SynchDisk::PrefetchDaemon
+// 	Body of the prefetcher thread: read each queued sector into the
+//	cache, unless somebody has read it in the meantime.
+//
+//	All the sectors queued are started at once, so that the disk
+//	queue can order them, and each is marked not busy as soon as it
+//	arrives.  At most half the cache is filled by one batch; if no
+//	entry is free at all, the rest of the batch is dropped.
 //----------------------------------------------------------------------
 
 void
-SynchDisk::RequestDone()
-{ 
-    semaphore->V();
+SynchDisk::PrefetchDaemon()
+{
+    DiskRequest *batch[PrefetchQueueSize];
+    CacheEntry *filling[PrefetchQueueSize];
+
+    for (;;) {
+	int count = 0;
+
+	prefetchNeeded->P();
+	lock->Acquire();
+	while (prefetchCount > 0) {
+	    int sectorNumber = prefetchQueue[prefetchHead];
+	    CacheEntry *entry;
+
+	    prefetchHead = (prefetchHead + 1) % PrefetchQueueSize;
+	    prefetchCount--;
+	    if (Lookup(sectorNumber) != NULL || count >= numEntries / 2)
+		continue;
+	    if ((entry = Allocate(sectorNumber)) == NULL)
+		continue;		// the cache is busy; drop it
+	    batch[count] = new DiskRequest(sectorNumber, entry->data, FALSE);
+	    filling[count++] = entry;
+	    disks->Submit(batch[count - 1]);
+	}
+	lock->Release();
+
+	for (int i = 0; i < count; i++) {
+	    batch[i]->Wait();
+	    delete batch[i];
+	    lock->Acquire();
+	    filling[i]->busy = FALSE;
+	    filling[i]->lastUsed = ++useClock;
+	    ioDone->Broadcast(lock);
+	    stats->numReadAheads++;
+	    lock->Release();
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write every dirty sector in the cache back to disk.  A sector
+//	written again while its old contents are on the way out is just
+//	dirty again.
+//
+//	Copies of all the dirty sectors are queued at once, so that the
+//	disk queue can write them in whatever order suits the head, and
+//	the cache is free for others while they go out.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    DiskRequest **batch;
+    char *copies;
+    int count = 0;
+
+    lock->Acquire();
+    for (int i = 0; i < numEntries; i++)
+	if (cache[i].dirty && !cache[i].busy)
+	    count++;
+    if (count == 0) {
+	lock->Release();
+	return;
+    }
+    batch = new DiskRequest *[count];
+    copies = new char[count * SectorSize];
+    count = 0;
+    for (int i = 0; i < numEntries; i++)
+	if (cache[i].dirty && !cache[i].busy) {
+	    char *copy = copies + count * SectorSize;
+
+	    bcopy(cache[i].data, copy, SectorSize);
+	    cache[i].dirty = FALSE;
+	    batch[count] = new DiskRequest(cache[i].sector, copy, TRUE);
+	    disks->Submit(batch[count++]);
+	}
+    writesOut += count;
+    lock->Release();
+
+    for (int i = 0; i < count; i++) {
+	batch[i]->Wait();
+	delete batch[i];
+    }
+    delete [] batch;
+    delete [] copies;
+    lock->Acquire();
+    writesOut -= count;
+    ioDone->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Write every dirty sector to disk, and return only once they, and
+//	any sectors other threads were already writing out, are all on
+//	disk.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    Flush();
+    if (numEntries == 0)
+	return;				// every write waited already
+    lock->Acquire();
+    while (writesOut > 0)
+	ioDone->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FlushDaemon
+// 	Body of the flusher thread: each time the flush timer goes off,
+//	write the dirty sectors out.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FlushDaemon()
+{
+    for (;;) {
+	flushNeeded->P();
+	DEBUG('f', "Flushing the sector cache\n");
+	Flush();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FlushTimeout
+// 	Flush timer interrupt handler.  Can't do disk I/O here, so just
+//	wake up the flusher thread.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FlushTimeout()
+{
+    flushPending = FALSE;
+    flushNeeded->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartFlushTimer
+// 	A sector has just been made dirty.  Make sure it will be flushed
+//	within FlushInterval ticks.  The timer only runs while there is
+//	something to flush, so that an idle machine can still halt.
+//	The caller holds the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartFlushTimer()
+{
+    if (flushPending)
+	return;
+    if (!flusherForked) {
+	Thread *t = new Thread("disk flusher");
+
+	flusherForked = TRUE;
+	t->Fork(DiskFlushDaemon, (int) this);
+    }
+    flushPending = TRUE;
+    interrupt->Schedule(DiskFlushTimeout, (int) this, FlushInterval, TimerInt);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Lookup
+// 	Return the cache entry holding "sectorNumber", or NULL if the
+//	sector is not cached.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Lookup(int sectorNumber)
+{
+    for (int i = 0; i < numEntries; i++)
+	if (cache[i].sector == sectorNumber)
+	    return &cache[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Allocate
+// 	Return a cache entry to hold "sectorNumber": an unused one if
+//	there is one, otherwise the least recently used one that is not
+//	busy, written back first if it is dirty.  The entry is returned
+//	busy, for the caller to fill in and then mark not busy.
+//
+//	If every entry is busy, wait for one to be done, and return NULL;
+//	the caller must then look the sector up again, since somebody
+//	else may have brought it in meanwhile.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Allocate(int sectorNumber)
+{
+    CacheEntry *victim = NULL;
+    int oldSector;
+
+    for (int i = 0; i < numEntries; i++) {
+	if (cache[i].busy)
+	    continue;
+	if (cache[i].sector == -1) {
+	    victim = &cache[i];
+	    break;
+	}
+	if (victim == NULL || cache[i].lastUsed < victim->lastUsed)
+	    victim = &cache[i];
+    }
+    if (victim == NULL) {
+	ioDone->Wait(lock);
+	return NULL;
+    }
+
+    // claim the entry before letting go of the lock to write it out
+    oldSector = victim->sector;
+    victim->sector = sectorNumber;
+    victim->busy = TRUE;
+    if (oldSector != -1)
+	stats->numCacheEvictions++;
+    if (victim->dirty) {
+	victim->dirty = FALSE;
+	WriteOut(oldSector, victim->data);
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskRead/DiskWrite
+// 	Transfer a sector between "data" and the disk, and wait for the
+//	transfer to finish.  The caller does not hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::DiskRead(int sectorNumber, char* data)
+{
+    Transfer(sectorNumber, data, FALSE);
+}
+
+void
+SynchDisk::DiskWrite(int sectorNumber, char* data)
+{
+    Transfer(sectorNumber, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Queue a request for the disk, and wait until it is done.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int sectorNumber, char* data, bool writing)
+{
+    DiskRequest request(sectorNumber, data, writing);
+
+    disks->Submit(&request);
+    request.Wait();			// wait for interrupt
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteOut
+// 	Write a copy of "data" to "sectorNumber", letting go of the lock
+//	while waiting.  The request is queued before the lock is let go,
+//	so that anybody reading the sector after that is served the new
+//	data by the queue.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteOut(int sectorNumber, char* data)
+{
+    char copy[SectorSize];
+    DiskRequest request(sectorNumber, copy, TRUE);
+
+    bcopy(data, copy, SectorSize);
+    disks->Submit(&request);
+    writesOut++;
+    lock->Release();
+    request.Wait();
+    lock->Acquire();
+    writesOut--;
+    ioDone->Broadcast(lock);
 }
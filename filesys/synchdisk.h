@@ -12,8 +12,25 @@
 #define SYNCHDISK_H
 
 #include "disk.h"
+#include "diskarray.h"
 #include "synch.h"
 
+#define CacheSize 	32	// default number of sectors in the cache
+#define FlushInterval 	50000	// most ticks a sector stays dirty
+#define PrefetchQueueSize 16	// sectors waiting to be read ahead
+
+// The following class defines one slot of the sector cache.
+
+class CacheEntry {
+  public:
+    int sector;				// sector held here, or -1 if none
+    bool dirty;				// modified since it came from disk?
+    bool busy;				// still being read in from disk?
+    int lastUsed;			// when it was last read or written,
+					// for LRU replacement
+    char data[SectorSize];		// the contents of the sector
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -23,12 +40,36 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests from different threads wait in a DiskQueue,
+// which decides the order the disk serves them in; there is one queue
+// per disk, if the sectors are spread over several (see DiskArray).
+//
+// Recently used sectors are kept in a cache, so that a read of a sector
+// that is already in memory never goes to the disk.  The cache is
+// write-back: a write only changes the cached copy, and dirty sectors
+// go out to disk when they are evicted, when a flusher thread gets to
+// them (at most FlushInterval ticks later), or when Nachos halts.
+//
+// A journal, if the file system has one, sees every sector written
+// before the cache does (see journal.h).
+//
+// A caller that expects to need a sector soon can ask for it to be
+// read into the cache in the background, by a prefetcher thread, so
+// that the later ReadSector is a hit.
+
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
-					// by initializing the raw Disk.
-    ~SynchDisk();			// De-allocate the synch disk data
+    SynchDisk(char* name, int cacheSize = CacheSize,
+			DiskPolicy policy = DiskCLOOK, char *modelName = "hdd",
+			int numDisks = 1, ArrayLayout layout = ArrayStripe);
+    					// Initialize a synchronous disk,
+					// by initializing the raw disks.
+					// A "cacheSize" of 0 turns the
+					// cache off; "policy" schedules
+					// the disk queues, and "modelName"
+					// times the disks (see Disk).
+    ~SynchDisk();			// De-allocate the synch disk data,
+					// after writing out dirty sectors
     
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
@@ -37,17 +78,53 @@ class SynchDisk {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+    void Install(int sectorNumber, char* data);
+					// Write, bypassing the journal
     
-    void RequestDone();			// Called by the disk device interrupt
-					// handler, to signal that the
-					// current disk operation is complete.
+    void Start(DiskRequest *request);	// Start a read or write, and return
+					// without waiting for it
+
+    void Prefetch(int sectorNumber);	// Start reading a sector into the
+					// cache, without waiting for it
+
+    void Flush();			// Write every dirty sector to disk
+    void Sync();			// Flush, and wait until every write
+					// started so far is on disk
+    void FlushDaemon();			// Body of the flusher thread
+    void FlushTimeout();		// Called by the flush timer interrupt
+    void PrefetchDaemon();		// Body of the prefetcher thread
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskArray *disks;			// Raw disk devices, and the
+					// requests waiting for them
+    Lock *lock;		  		// Protects the cache; not held while
+					// waiting for the disk
+    Condition *ioDone;			// Signalled when a cache entry stops
+					// being busy
+
+    CacheEntry *cache;			// the cached sectors
+    int numEntries;			// size of "cache"
+    int useClock;			// source of CacheEntry::lastUsed
+    int writesOut;			// dirty sectors on their way to disk
+    Semaphore *flushNeeded;		// the flusher thread waits here
+    bool flusherForked;			// Has the flusher thread started?
+    bool flushPending;			// Is the flush timer running?
+
+    int prefetchQueue[PrefetchQueueSize];	// sectors to read ahead,
+    int prefetchHead;			// a circular queue starting at
+    int prefetchCount;			// "prefetchHead"
+    Semaphore *prefetchNeeded;		// the prefetcher thread waits here
+    bool prefetcherForked;		// Has the prefetcher thread started?
+
+    CacheEntry *Lookup(int sectorNumber);	// Find a cached sector
+    CacheEntry *Allocate(int sectorNumber);	// Make room for a sector
+    void StartFlushTimer();		// A sector just became dirty
+    void DiskRead(int sectorNumber, char* data);
+    void DiskWrite(int sectorNumber, char* data);
+					// Go straight to the disk
+    void Transfer(int sectorNumber, char* data, bool writing);
+    void WriteOut(int sectorNumber, char* data);
+					// Write a copy, with the lock held
 };
 
 #endif // SYNCHDISK_H
@@ -7,6 +7,13 @@
 //	Disk operations are asynchronous, so we have to invoke an interrupt
 //	handler when the simulated operation completes.
 //
+//	The UNIX file is mapped into memory if it can be, so that a
+//	sector is moved with a copy instead of two system calls; the
+//	mapping is written back when the disk is deleted, at halt.  This
+//	only changes how fast the simulation runs, not the simulated time
+//	each request takes.  Compile with -DNODISKMAP to always use
+//	read and write.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -15,6 +22,7 @@
 
 #include "copyright.h"
 #include "disk.h"
+#include "latency.h"
 #include "system.h"
 
 // We put this at the front of the UNIX file representing the
@@ -38,9 +46,12 @@ static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
 //	   request completes
 //	"callArg" -- argument to pass the interrupt handler
+//	"latencyModel" -- how long requests take; NULL means a rotating
+//	   disk, as in HddModel
 //----------------------------------------------------------------------
 
-Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
+Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+						LatencyModel *latencyModel)
 {
     int magicNum;
     int tmp = 0;
@@ -48,8 +59,10 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
     DEBUG('d', "Initializing the disk, 0x%x 0x%x\n", callWhenDone, callArg);
     handler = callWhenDone;
     handlerArg = callArg;
-    lastSector = 0;
-    bufferInit = 0;
+    model = (latencyModel != NULL) ? latencyModel : new HddModel();
+    ASSERT(model->Parallelism() <= MaxDiskParallelism);
+    ASSERT(stats->numDisks < MaxDisks);
+    stats->diskModels[stats->numDisks++] = model;
     
     fileno = OpenForReadWrite(name, FALSE);
     if (fileno >= 0) {		 	// file exists, check magic number 
@@ -64,18 +77,60 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
         Lseek(fileno, DiskSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
-    active = FALSE;
+#ifndef NODISKMAP
+    image = MapFile(fileno, DiskSize);
+#else
+    image = NULL;
+#endif
+    DEBUG('d', "Disk image %s\n", image != NULL ? "mapped" : "not mapped");
+    numActive = 0;
+    doneSector = -1;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk.  If it is mapped, the mapping is written back first.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (image != NULL)
+	UnmapFile(image, DiskSize);
     Close(fileno);
+    for (int i = 0; i < stats->numDisks; i++)
+	if (stats->diskModels[i] == model)
+	    stats->diskModels[i] = NULL;
+    delete model;
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadSector/WriteSector
+// 	Move a sector between "data" and the UNIX file, right away: by
+//	copying, if the file is mapped, or else by seeking and reading
+//	or writing.
+//----------------------------------------------------------------------
+
+void
+Disk::ReadSector(int sectorNumber, char* data)
+{
+    if (image != NULL)
+	bcopy(image + SectorSize * sectorNumber + MagicSize, data, SectorSize);
+    else {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	Read(fileno, data, SectorSize);
+    }
+}
+
+void
+Disk::WriteSector(int sectorNumber, char* data)
+{
+    if (image != NULL)
+	bcopy(data, image + SectorSize * sectorNumber + MagicSize, SectorSize);
+    else {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	WriteFile(fileno, data, SectorSize);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -106,7 +161,8 @@ PrintSector (bool writing, int sector, char *data)
 //	      the operation has completed.
 //
 //	Note that a disk only allows an entire sector to be read/written,
-//	not part of a sector.
+//	not part of a sector.  Up to Parallelism() requests, for different
+//	sectors, can be in progress at once.
 //
 //	"sectorNumber" -- the disk sector to read/write
 //	"data" -- the bytes to be written, the buffer to hold the incoming bytes
@@ -115,35 +171,33 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    int ticks;
 
-    ASSERT(!active);				// only one request at a time
+    ASSERT(numActive < model->Parallelism());	// too many requests at once
     //printf("in Disk::ReadRequest, sectornumber is %d\n", sectorNumber);
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ticks = model->Latency(sectorNumber, FALSE);
     
     DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    ReadSector(sectorNumber, data);
     if (DebugIsEnabled('d'))
 	PrintSector(FALSE, sectorNumber, data);
     
-    active = TRUE;
-    UpdateLast(sectorNumber);
+    Started(sectorNumber, ticks);
     stats->numDiskReads++;
-    interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 void
 Disk::WriteRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks;
 
-    ASSERT(!active);
+    ASSERT(numActive < model->Parallelism());
     ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ticks = model->Latency(sectorNumber, TRUE);
     
     DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    WriteSector(sectorNumber, data);
     if (DebugIsEnabled('d'))
 	PrintSector(TRUE, sectorNumber, data);
     
@@ -151,126 +205,88 @@ Disk::WriteRequest(int sectorNumber, char* data)
     //PrintSector(TRUE, sectorNumber, data);
 
 
-    active = TRUE;
-    UpdateLast(sectorNumber);
+    Started(sectorNumber, ticks);
     stats->numDiskWrites++;
-    interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 //----------------------------------------------------------------------
-// Disk::HandleInterrupt()
-// 	Called when it is time to invoke the disk interrupt handler,
-//	to tell the Nachos kernel that the disk request is done.
+// Disk::Started
+// 	Note that a request for "sectorNumber" is in progress, and will
+//	be done "ticks" from now.
 //----------------------------------------------------------------------
 
 void
-Disk::HandleInterrupt ()
-{ 
-    active = FALSE;
-    (*handler)(handlerArg);
+Disk::Started(int sectorNumber, int ticks)
+{
+    for (int i = 0; i < numActive; i++)
+	ASSERT(activeSector[i] != sectorNumber);
+    activeSector[numActive] = sectorNumber;
+    activeDoneAt[numActive] = stats->totalTicks + ticks;
+    numActive++;
+    interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 //----------------------------------------------------------------------
-// Disk::TimeToSeek()
-//	Returns how long it will take to position the disk head over the correct
-//	track on the disk.  Since when we finish seeking, we are likely
-//	to be in the middle of a sector that is rotating past the head,
-//	we also return how long until the head is at the next sector boundary.
-//	
-//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
+// Disk::WriteImmediate
+// 	Write a single disk sector right away, without an interrupt.
+//	Only for use while Nachos is halting: there is no simulated time
+//	left to wait in, but cached data still has to reach the disk.
+//
+//	"sectorNumber" -- the disk sector to write
+//	"data" -- the bytes to be written
 //----------------------------------------------------------------------
 
-int
-Disk::TimeToSeek(int newSector, int *rotation) 
+void
+Disk::WriteImmediate(int sectorNumber, char* data)
 {
-    int newTrack = newSector / SectorsPerTrack;
-    int oldTrack = lastSector / SectorsPerTrack;
-    int seek = abs(newTrack - oldTrack) * SeekTime;
-				// how long will seek take?
-    int over = (stats->totalTicks + seek) % RotationTime; 
-				// will we be in the middle of a sector when
-				// we finish the seek?
-
-    *rotation = 0;
-    if (over > 0)	 	// if so, need to round up to next full sector
-   	*rotation = RotationTime - over;
-    return seek;
+    ASSERT(numActive == 0);
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+
+    DEBUG('d', "Writing to sector %d at shutdown\n", sectorNumber);
+    WriteSector(sectorNumber, data);
+    if (DebugIsEnabled('d'))
+	PrintSector(TRUE, sectorNumber, data);
+    stats->numDiskWrites++;
 }
 
 //----------------------------------------------------------------------
-// Disk::ModuloDiff()
-// 	Return number of sectors of rotational delay between target sector
-//	"to" and current sector position "from"
+// Disk::HandleInterrupt()
+// 	Called when it is time to invoke the disk interrupt handler,
+//	to tell the Nachos kernel that the disk request is done.  If
+//	several requests are in progress, this is the one due soonest;
+//	DoneSector tells the handler which it was.
 //----------------------------------------------------------------------
 
-int 
-Disk::ModuloDiff(int to, int from)
-{
-    int toOffset = to % SectorsPerTrack;
-    int fromOffset = from % SectorsPerTrack;
-
-    return ((toOffset - fromOffset) + SectorsPerTrack) % SectorsPerTrack;
+void
+Disk::HandleInterrupt ()
+{ 
+    int which = 0;
+
+    ASSERT(numActive > 0);
+    for (int i = 1; i < numActive; i++)
+	if (activeDoneAt[i] < activeDoneAt[which])
+	    which = i;
+    doneSector = activeSector[which];
+    numActive--;
+    activeSector[which] = activeSector[numActive];
+    activeDoneAt[which] = activeDoneAt[numActive];
+    (*handler)(handlerArg);
 }
 
 //----------------------------------------------------------------------
-// Disk::ComputeLatency()
-// 	Return how long will it take to read/write a disk sector, from
-//	the current position of the disk head.
-//
-//   	Latency = seek time + rotational latency + transfer time
-//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
-//
-//   	To find the rotational latency, we first must figure out where the 
-//   	disk head will be after the seek (if any).  We then figure out
-//   	how long it will take to rotate completely past newSector after 
-//	that point.
-//
-//   	The disk also has a "track buffer"; the disk continuously reads
-//   	the contents of the current disk track into the buffer.  This allows 
-//   	read requests to the current track to be satisfied more quickly.
-//   	The contents of the track buffer are discarded after every seek to 
-//   	a new track.
+// Disk::TimeToSeek, Disk::CurrentTrack
+// 	Ask the latency model where the head is, for scheduling.  See
+//	HddModel::TimeToSeek.
 //----------------------------------------------------------------------
 
 int
-Disk::ComputeLatency(int newSector, bool writing)
+Disk::TimeToSeek(int newSector, int *rotation)
 {
-    int rotation;
-    int seek = TimeToSeek(newSector, &rotation);
-    int timeAfter = stats->totalTicks + seek + rotation;
-
-#ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
-    // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0) 
-		&& (((timeAfter - bufferInit) / RotationTime) 
-	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
-        DEBUG('d', "Request latency = %d\n", RotationTime);
-	return RotationTime; // time to transfer sector from the track buffer
-    }
-#endif
-
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
-
-    DEBUG('d', "Request latency = %d\n", seek + rotation + RotationTime);
-    return(seek + rotation + RotationTime);
+    return model->TimeToSeek(newSector, rotation);
 }
 
-//----------------------------------------------------------------------
-// Disk::UpdateLast
-//   	Keep track of the most recently requested sector.  So we can know
-//	what is in the track buffer.
-//----------------------------------------------------------------------
-
-void
-Disk::UpdateLast(int newSector)
+int
+Disk::CurrentTrack()
 {
-    int rotate;
-    int seek = TimeToSeek(newSector, &rotate);
-    
-    if (seek != 0)
-	bufferInit = stats->totalTicks + seek + rotate;
-    lastSector = newSector;
-    DEBUG('d', "Updating last sector = %d, %d\n", lastSector, bufferInit);
+    return model->CurrentTrack();
 }
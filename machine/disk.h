@@ -19,6 +19,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "latency.h"
 
 // The following class defines a physical disk I/O device.  The disk
 // has a single surface, split up into "tracks", and each track split
@@ -32,7 +33,8 @@
 // requests to read or write portions of the disk return immediately,
 // and an interrupt is invoked later to signal that the operation completed.
 //
-// The physical disk is in fact simulated via operations on a UNIX file.
+// The physical disk is in fact simulated via operations on a UNIX file,
+// mapped into memory where the host allows it.
 //
 // To make life a little more realistic, the simulated time for
 // each operation reflects a "track buffer" -- RAM to store the contents
@@ -45,49 +47,67 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// All of this timing is done by a LatencyModel (see latency.h); the
+// rotating disk described above is the default, but the disk can be
+// made to behave like flash instead.  A model may let the disk work on
+// several requests at once.
 
 #define SectorSize 		128	// number of bytes per disk sector
 #define SectorsPerTrack 	32	// number of sectors per disk track 
-#define NumTracks 		32	// number of tracks per disk
+#define NumTracks 		512	// number of tracks per disk (2MB)
 #define NumSectors 		(SectorsPerTrack * NumTracks)
 					// total # of sectors per disk
 
 class Disk {
   public:
-    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg);
+    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+				LatencyModel *latencyModel = NULL);
     					// Create a simulated disk.  
 					// Invoke (*callWhenDone)(callArg) 
 					// every time a request completes.
+					// The disk owns "latencyModel".
     ~Disk();				// Deallocate the disk.
     
     void ReadRequest(int sectorNumber, char* data);
     					// Read/write an single disk sector.
 					// These routines send a request to 
     					// the disk and return immediately.
-    					// Only one request allowed at a time!
+    					// Only Parallelism() requests are
+					// allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
+    void WriteImmediate(int sectorNumber, char* data);
+					// Write a sector with no simulated
+					// delay, for use at shutdown only
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
+    int DoneSector() { return doneSector; }
+					// Which request just finished
 
-    int ComputeLatency(int newSector, bool writing);	
-    					// Return how long a request to 
-					// newSector will take: 
-					// (seek + rotational delay + transfer)
+    int Parallelism() { return model->Parallelism(); }
+					// How many requests at once
+    int TimeToSeek(int newSector, int *rotate); // time to get to the new track
+    int CurrentTrack();			// Where the head is now
 
   private:
     int fileno;				// UNIX file number for simulated disk 
+    char *image;			// the UNIX file mapped into memory,
+					// or NULL if it isn't
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     int handlerArg;			// Argument to interrupt handler 
-    bool active;     			// Is a disk operation in progress?
-    int lastSector;			// The previous disk request 
-    int bufferInit;			// When the track buffer started 
-					// being loaded
+    LatencyModel *model;		// How long requests take
+    int numActive;     			// How many requests are in progress
+    int activeSector[MaxDiskParallelism];	// their sectors,
+    int activeDoneAt[MaxDiskParallelism];	// and when they will be done
+    int doneSector;			// The request just finished
 
-    int TimeToSeek(int newSector, int *rotate); // time to get to the new track
-    int ModuloDiff(int to, int from);        // # sectors between to and from
-    void UpdateLast(int newSector);
+    void Started(int sectorNumber, int ticks);
+					// A request is now in progress
+    void ReadSector(int sectorNumber, char* data);
+    void WriteSector(int sectorNumber, char* data);
+					// Move the data to/from the file
 };
 
 #endif // DISK_H
@@ -0,0 +1,269 @@
+// latency.cc
+//	Routines to compute how long simulated disk requests take, under
+//	each of the latency models.  See latency.h.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "latency.h"
+#include "disk.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// NewLatencyModel
+// 	Return a new model, given its name, or NULL if there is no model
+//	of that name.
+//----------------------------------------------------------------------
+
+LatencyModel *
+NewLatencyModel(char *name)
+{
+    if (!strcmp(name, "hdd"))
+	return new HddModel();
+    if (!strcmp(name, "ssd"))
+	return new SsdModel("ssd", SsdReadTime, SsdWriteTime, SsdChannels);
+    if (!strcmp(name, "nvme"))
+	return new SsdModel("nvme", NvmeReadTime, NvmeWriteTime, NvmeChannels);
+    if (!strcmp(name, "zero"))
+	return new ZeroModel();
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// HddModel::HddModel
+// 	Initialize a rotating disk, with the head over sector 0.
+//----------------------------------------------------------------------
+
+HddModel::HddModel()
+{
+    lastSector = 0;
+    bufferInit = 0;
+    numRequests = numSeeks = seekTicks = rotationTicks = 0;
+    numTrackBufferHits = 0;
+}
+
+//----------------------------------------------------------------------
+// HddModel::Latency
+// 	Return how long it will take to read/write a disk sector, from
+//	the current position of the disk head, and move the head there.
+//
+//   	Latency = seek time + rotational latency + transfer time
+//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
+//   	and rotates at one sector per RotationTime ticks
+//
+//   	To find the rotational latency, we first must figure out where the
+//   	disk head will be after the seek (if any).  We then figure out
+//   	how long it will take to rotate completely past newSector after
+//	that point.
+//
+//   	The disk also has a "track buffer"; the disk continuously reads
+//   	the contents of the current disk track into the buffer.  This allows
+//   	read requests to the current track to be satisfied more quickly.
+//   	The contents of the track buffer are discarded after every seek to
+//   	a new track.
+//----------------------------------------------------------------------
+
+int
+HddModel::Latency(int newSector, bool writing)
+{
+    int rotation;
+    int seek = TimeToSeek(newSector, &rotation);
+    int timeAfter = stats->totalTicks + seek + rotation;
+
+    numRequests++;
+    if (seek > 0) {
+	numSeeks++;
+	seekTicks += seek;
+    }
+#ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
+    // check if track buffer applies
+    if ((writing == FALSE) && (seek == 0)
+		&& (((timeAfter - bufferInit) / RotationTime)
+	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
+        DEBUG('d', "Request latency = %d\n", RotationTime);
+	numTrackBufferHits++;
+	UpdateLast(newSector);
+	return RotationTime; // time to transfer sector from the track buffer
+    }
+#endif
+
+    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    rotationTicks += rotation;
+
+    DEBUG('d', "Request latency = %d\n", seek + rotation + RotationTime);
+    UpdateLast(newSector);
+    return(seek + rotation + RotationTime);
+}
+
+//----------------------------------------------------------------------
+// HddModel::TimeToSeek
+//	Returns how long it will take to position the disk head over the correct
+//	track on the disk.  Since when we finish seeking, we are likely
+//	to be in the middle of a sector that is rotating past the head,
+//	we also return how long until the head is at the next sector boundary.
+//
+//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
+//   	and rotates at one sector per RotationTime ticks
+//----------------------------------------------------------------------
+
+int
+HddModel::TimeToSeek(int newSector, int *rotation)
+{
+    int newTrack = newSector / SectorsPerTrack;
+    int oldTrack = lastSector / SectorsPerTrack;
+    int seek = abs(newTrack - oldTrack) * SeekTime;
+				// how long will seek take?
+    int over = (stats->totalTicks + seek) % RotationTime;
+				// will we be in the middle of a sector when
+				// we finish the seek?
+
+    *rotation = 0;
+    if (over > 0)	 	// if so, need to round up to next full sector
+   	*rotation = RotationTime - over;
+    return seek;
+}
+
+//----------------------------------------------------------------------
+// HddModel::CurrentTrack
+// 	Return the track the head is over.
+//----------------------------------------------------------------------
+
+int
+HddModel::CurrentTrack()
+{
+    return lastSector / SectorsPerTrack;
+}
+
+//----------------------------------------------------------------------
+// HddModel::ModuloDiff
+// 	Return number of sectors of rotational delay between target sector
+//	"to" and current sector position "from"
+//----------------------------------------------------------------------
+
+int
+HddModel::ModuloDiff(int to, int from)
+{
+    int toOffset = to % SectorsPerTrack;
+    int fromOffset = from % SectorsPerTrack;
+
+    return ((toOffset - fromOffset) + SectorsPerTrack) % SectorsPerTrack;
+}
+
+//----------------------------------------------------------------------
+// HddModel::UpdateLast
+//   	Keep track of the most recently requested sector.  So we can know
+//	what is in the track buffer.
+//----------------------------------------------------------------------
+
+void
+HddModel::UpdateLast(int newSector)
+{
+    int rotate;
+    int seek = TimeToSeek(newSector, &rotate);
+
+    if (seek != 0)
+	bufferInit = stats->totalTicks + seek + rotate;
+    lastSector = newSector;
+    DEBUG('d', "Updating last sector = %d, %d\n", lastSector, bufferInit);
+}
+
+//----------------------------------------------------------------------
+// HddModel::Print
+// 	Print where the time went.
+//----------------------------------------------------------------------
+
+void
+HddModel::Print(int disk)
+{
+    printf("Disk %d (hdd): requests %d, seeks %d (%d ticks), "
+	"rotational delay %d ticks, track buffer hits %d\n", disk,
+	numRequests, numSeeks, seekTicks, rotationTicks, numTrackBufferHits);
+}
+
+//----------------------------------------------------------------------
+// SsdModel::SsdModel
+// 	Initialize a flash device, with every channel idle.
+//
+//	"name" -- what to call it, for printing
+//	"readTime", "writeTime" -- how long a channel takes per request
+//	"channels" -- how many channels work in parallel
+//----------------------------------------------------------------------
+
+SsdModel::SsdModel(char *theName, int theReadTime, int theWriteTime,
+							int channels)
+{
+    ASSERT(channels > 0 && channels <= MaxDiskParallelism);
+    name = theName;
+    readTime = theReadTime;
+    writeTime = theWriteTime;
+    numChannels = channels;
+    channelFree = new int[numChannels];
+    for (int i = 0; i < numChannels; i++)
+	channelFree[i] = 0;
+    numReads = numWrites = busyTicks = numWaits = waitTicks = 0;
+}
+
+SsdModel::~SsdModel()
+{
+    delete [] channelFree;
+}
+
+//----------------------------------------------------------------------
+// SsdModel::Latency
+// 	Return how long a request for "sector" takes: the fixed cost of
+//	a read or write, after waiting for its channel if it is busy.
+//----------------------------------------------------------------------
+
+int
+SsdModel::Latency(int sector, bool writing)
+{
+    int channel = sector % numChannels;
+    int now = stats->totalTicks;
+    int start = (channelFree[channel] > now) ? channelFree[channel] : now;
+    int cost = writing ? writeTime : readTime;
+
+    if (writing)
+	numWrites++;
+    else
+	numReads++;
+    if (start > now) {
+	numWaits++;
+	waitTicks += start - now;
+    }
+    busyTicks += cost;
+    channelFree[channel] = start + cost;
+    DEBUG('d', "Request latency = %d, channel %d\n", start + cost - now,
+								channel);
+    return start + cost - now;
+}
+
+//----------------------------------------------------------------------
+// SsdModel::Print
+// 	Print how busy the channels were.
+//----------------------------------------------------------------------
+
+void
+SsdModel::Print(int disk)
+{
+    int total = stats->totalTicks * numChannels;
+
+    printf("Disk %d (%s): reads %d, writes %d, channels %d busy %d%%, "
+	"waits for a busy channel %d (%d ticks)\n", disk, name, numReads,
+	numWrites, numChannels,
+	(total > 0) ? (int) ((busyTicks * 100.0) / total) : 0,
+	numWaits, waitTicks);
+}
+
+//----------------------------------------------------------------------
+// ZeroModel::Print
+//----------------------------------------------------------------------
+
+void
+ZeroModel::Print(int disk)
+{
+    printf("Disk %d (zero): requests %d\n", disk, numRequests);
+}
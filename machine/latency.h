@@ -0,0 +1,142 @@
+// latency.h
+//	Models of how long the simulated disk takes to do a request.
+//
+//	The disk itself only moves data to and from the UNIX file; the
+//	model decides how many ticks each request takes, and how many
+//	requests the device can work on at once.  This way kernel policies
+//	can be compared on different kinds of storage:
+//
+//	   hdd  -- a rotating disk, with seeks, rotational delay and a
+//		   track buffer (the original Nachos disk)
+//	   ssd  -- flash, with a fixed cost per read and per write, and
+//		   several channels working in parallel
+//	   nvme -- like ssd, but faster and with more channels
+//	   zero -- every request takes a single tick, for profiling the
+//		   kernel without waiting for the disk
+//
+//	Each disk has a model of its own, which keeps its own statistics,
+//	printed at halt.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define MaxDiskParallelism 	16	// most requests a device can
+					// work on at once
+
+// Costs of the flash models, in ticks (cf. RotationTime in stats.h).
+// Sectors are striped across the channels; a channel does one request
+// at a time.
+
+#define SsdReadTime 		100
+#define SsdWriteTime 		400
+#define SsdChannels 		4
+#define NvmeReadTime 		25
+#define NvmeWriteTime 		100
+#define NvmeChannels 		16
+
+// The following class defines the interface every model provides.
+// Latency is called as each request is handed to the device.
+
+class LatencyModel {
+  public:
+    virtual ~LatencyModel() {}
+
+    virtual char *Name() = 0;		// for printing
+    virtual int Latency(int sector, bool writing) = 0;
+					// How many ticks from now a request
+					// starting now will be done in
+    virtual int Parallelism() { return 1; }
+					// How many requests at once
+    virtual int TimeToSeek(int sector, int *rotation)
+	{ *rotation = 0; return 0; }	// How long before the device could
+					// start on "sector"; nothing moves
+					// unless the model has a head
+    virtual int CurrentTrack() { return 0; }
+					// Where the head is, if any
+    virtual void Print(int disk) = 0;	// Print the model's statistics,
+					// for disk number "disk"
+};
+
+// The rotating disk.  This is the model the Nachos disk always had;
+// see disk.h for how the track buffer works.  The track buffer can be
+// disabled by compiling with -DNOTRACKBUF.
+
+class HddModel : public LatencyModel {
+  public:
+    HddModel();
+
+    char *Name() { return "hdd"; }
+    int Latency(int sector, bool writing);
+    int TimeToSeek(int sector, int *rotation);
+    int CurrentTrack();
+    void Print(int disk);
+
+  private:
+    int lastSector;			// The previous disk request
+    int bufferInit;			// When the track buffer started
+					// being loaded
+    int numRequests;			// requests done
+    int numSeeks;			// requests that moved the head
+    int seekTicks;			// total time spent seeking
+    int rotationTicks;			// total rotational delay
+    int numTrackBufferHits;		// reads served by the track buffer
+
+    int ModuloDiff(int to, int from);	// # sectors between to and from
+    void UpdateLast(int newSector);
+};
+
+// Flash.  No positioning delays, but every request keeps the channel
+// that holds its sector busy for a fixed time; requests to different
+// channels overlap.
+
+class SsdModel : public LatencyModel {
+  public:
+    SsdModel(char *name, int readTime, int writeTime, int channels);
+    ~SsdModel();
+
+    char *Name() { return name; }
+    int Latency(int sector, bool writing);
+    int Parallelism() { return numChannels; }
+    void Print(int disk);
+
+  private:
+    char *name;
+    int readTime, writeTime;		// ticks per request
+    int numChannels;
+    int *channelFree;			// when each channel is next idle
+
+    int numReads, numWrites;		// requests done
+    int busyTicks;			// total time channels were busy
+    int numWaits;			// requests that found their channel
+    int waitTicks;			// busy, and how long they waited
+};
+
+// No delay at all, beyond the single tick an interrupt takes.
+
+class ZeroModel : public LatencyModel {
+  public:
+    ZeroModel() { numRequests = 0; }
+
+    char *Name() { return "zero"; }
+    int Latency(int sector, bool writing) { numRequests++; return 1; }
+    void Print(int disk);
+
+  private:
+    int numRequests;			// requests done
+};
+
+// Return a new model, given its name ("hdd", "ssd", "nvme" or
+// "zero"), or NULL if there is no such model.
+
+extern LatencyModel *NewLatencyModel(char *name);
+
+#endif // LATENCY_H
@@ -329,6 +329,7 @@ Machine::LoadPage(int virtualAddr)
     //   pageTableSize, vpn, pageTable[vpn].valid);
     ASSERT(vpn < pageTableSize);
     ASSERT(!pageTable[vpn].valid);              //assert that this page is invalid
+    ASSERT(!pageTable[vpn].shared);		// detached segment; cf. Translate
     int minVirPage = -1;
     int minHitTimes = 2147483647;
 
@@ -345,7 +346,8 @@ Machine::LoadPage(int virtualAddr)
     //in this case, page replacement is not necessary
     for(int i=0; i<pageTableSize; i++)
     {
-        if(pageTable[i].valid && pageTable[i].hitTimes < minHitTimes)
+        if(pageTable[i].valid && !pageTable[i].shared
+            && pageTable[i].hitTimes < minHitTimes)
         {
             minHitTimes = pageTable[i].hitTimes;
             minVirPage = i;
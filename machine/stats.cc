@@ -10,6 +10,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "stats.h"
+#include "latency.h"
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +23,14 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numCacheHits = numCacheMisses = numCacheEvictions = 0;
+    numReadAheads = numWritesMerged = 0;
+    numDirUpdatesDeferred = numDirWriteBacks = 0;
+    numDiskRequests = diskQueueTicks = 0;
+    numJournalWrites = numJournalCommits = numJournalSectors = 0;
+    numJournalCheckpoints = numJournalOverflows = numJournalReplayed = 0;
+    diskPolicy = NULL;
+    numDisks = 0;
 }
 
 //----------------------------------------------------------------------
@@ -36,8 +45,26 @@ Statistics::Print()
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numDiskRequests > 0)
+	printf("Disk queue (%s): requests %d, average latency %d ticks\n",
+	    diskPolicy, numDiskRequests, diskQueueTicks / numDiskRequests);
+    for (int i = 0; i < numDisks; i++)
+	if (diskModels[i] != NULL)
+	    diskModels[i]->Print(i);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
+    printf("Buffer cache: hits %d, misses %d, evictions %d\n", numCacheHits,
+	numCacheMisses, numCacheEvictions);
+    printf("File I/O: sectors read ahead %d, small writes merged %d\n",
+	numReadAheads, numWritesMerged);
+    if (numDirUpdatesDeferred > 0)
+	printf("Directories: updates deferred %d, written back %d\n",
+	    numDirUpdatesDeferred, numDirWriteBacks);
+    if (numJournalWrites > 0 || numJournalReplayed > 0)
+	printf("Journal: writes %d, commits %d (%d sectors), checkpoints %d, "
+	    "overflows %d, sectors replayed %d\n", numJournalWrites,
+	    numJournalCommits, numJournalSectors, numJournalCheckpoints,
+	    numJournalOverflows, numJournalReplayed);
     printf("Paging: faults %d\n", numPageFaults);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
@@ -13,6 +13,10 @@
 
 #include "copyright.h"
 
+class LatencyModel;
+
+#define MaxDisks	8	// most simulated disks (cf. DiskArray)
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -35,6 +39,25 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numCacheHits;		// disk sector requests served from the cache
+    int numCacheMisses;		// disk sector requests that missed the cache
+    int numCacheEvictions;	// cached sectors replaced to make room
+    int numReadAheads;		// sectors read into the cache ahead of use
+    int numWritesMerged;	// small writes absorbed by a file's tail buffer
+    int numDirUpdatesDeferred;	// directory changes left in memory
+    int numDirWriteBacks;	// dirty directories written back later
+    int numDiskRequests;	// requests that went through the disk queue
+    int diskQueueTicks;		// their total time from submission to done
+    int numJournalWrites;	// sector writes taken by the journal
+    int numJournalCommits;	// groups committed to the log
+    int numJournalSectors;	// sectors written to the log in them
+    int numJournalCheckpoints;	// times the log was started over
+    int numJournalOverflows;	// writes that found the group full
+    int numJournalReplayed;	// sectors copied home from the log at mount
+    char *diskPolicy;		// how the disk queue is scheduled
+    LatencyModel *diskModels[MaxDisks];
+				// how long requests take on each disk;
+    int numDisks;		// each model keeps statistics of its own
 
     Statistics(); 		// initialize everything to zero
 
@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -265,6 +266,44 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "nBytes" of an open file into memory, shared, so
+//	that stores to the memory change the file.  Return the address
+//	of the mapping, or NULL if the file can't be mapped (for instance
+//	because it is shorter than "nBytes").
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int nBytes)
+{
+    struct stat info;
+    void *addr;
+
+    if (fstat(fd, &info) < 0 || info.st_size < nBytes)
+	return NULL;
+    addr = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+	return NULL;
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Write a mapping made by MapFile back to the file, and remove it.
+//	Abort on error.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int nBytes)
+{
+    int retVal = msync(addr, nBytes, MS_SYNC);
+
+    ASSERT(retVal == 0);
+    retVal = munmap(addr, nBytes);
+    ASSERT(retVal == 0);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
@@ -416,6 +455,22 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// WallTime
+// 	Return the UNIX time of day, in seconds, to the microsecond.
+//	Unlike stats->totalTicks, this measures how long the host takes
+//	to simulate something, not how long the simulated machine does.
+//----------------------------------------------------------------------
+
+double
+WallTime()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
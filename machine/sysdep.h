@@ -29,6 +29,10 @@ extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(char *name);
 
+// Map a file into memory, and write it back and unmap it
+extern char *MapFile(int fd, int nBytes);
+extern void UnmapFile(char *addr, int nBytes);
+
 // Interprocess communication operations, for simulating the network
 extern int OpenSocket();
 extern void CloseSocket(int sockID);
@@ -43,6 +47,9 @@ extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 
+// Host time of day, in seconds, for timing Nachos itself
+extern double WallTime();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
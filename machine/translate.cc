@@ -97,8 +97,9 @@ Machine::ReadMem(int addr, int size, int *value)
 	
     if (exception != NoException) 
     {
-		ASSERT(exception == PageFaultException);
 		machine->RaiseException(exception, addr);
+		if (exception != PageFaultException)
+		    return FALSE;	// bad address; the program is killed
 		exception = Translate(addr, &physicalAddress, size, FALSE);
 		ASSERT(exception == NoException);
     }
@@ -154,8 +155,9 @@ Machine::WriteMem(int addr, int size, int value)
 
  	if (exception != NoException) 
     {
-		ASSERT(exception == PageFaultException);
 		machine->RaiseException(exception, addr);
+		if (exception != PageFaultException)
+		    return FALSE;	// bad address; the program is killed
 		exception = Translate(addr, &physicalAddress, size, TRUE);
 		ASSERT(exception == NoException);
     }
@@ -262,6 +264,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 		}
 		if (entry == NULL) 
 		{				// not found
+		    if (pageTable != NULL && (vpn >= pageTableSize
+				|| (!pageTable[vpn].valid
+					&& pageTable[vpn].shared)))
+		    {		// past the end, or a detached shared segment
+			DEBUG('a', "virtual page # %d is not mapped!\n", vpn);
+			return AddressErrorException;
+		    }
     	    DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
@@ -43,6 +43,8 @@ class TranslationEntry {
     int hitTimes;
 
     int order;
+    bool shared;	// The physical page belongs to a shared memory
+			// segment: never replace it, never free it here.
 };
 
 #endif
@@ -0,0 +1,63 @@
+/* aiotest.c
+ *	Overlap file I/O with computation using AioWrite/AioRead/AioWait.
+ *
+ *	A block is written and read back asynchronously; while each
+ *	transfer is in progress the program keeps computing, polling
+ *	AioWait to see when it is done.  Exit status is the number of
+ *	bytes that came back wrong (0 = ok), or negative on error.
+ */
+
+#include "syscall.h"
+
+#define Size	128	/* Create makes files of this size */
+
+char out[Size], in[Size];
+int work = 0;
+
+/* Burn some cycles, as a stand-in for real computation. */
+void
+Compute()
+{
+    int i;
+
+    for (i = 0; i < 100; i++)
+	work += i;
+}
+
+/* Wait for "ticket", computing until it is done. */
+int
+Finish(int ticket)
+{
+    int result;
+
+    while ((result = AioWait(ticket, 1)) == AioPending)
+	Compute();
+    return result;
+}
+
+int
+main()
+{
+    OpenFileId fd;
+    int i, bad = 0;
+
+    for (i = 0; i < Size; i++)
+	out[i] = 'a' + i % 26;
+    out[Size - 1] = '\0';
+
+    Create("aiofile");
+    fd = Open("aiofile");
+    if (Finish(AioWrite(out, Size, fd)) != Size)
+	Exit(-1);
+    Close(fd);
+
+    fd = Open("aiofile");
+    if (Finish(AioRead(in, Size, fd)) != Size)
+	Exit(-2);
+    Close(fd);
+
+    for (i = 0; i < Size; i++)
+	if (in[i] != out[i])
+	    bad++;
+    Exit(bad);
+}
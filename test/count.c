@@ -0,0 +1,18 @@
+/* count.c
+ *	Read ConsoleInput until end of file, and exit with the number of
+ *	bytes read.  Meant for the far end of a pipeline in the shell,
+ *	e.g. "echo hello world | count" exits with status 12.
+ */
+
+#include "syscall.h"
+
+int
+main()
+{
+    char buffer[32];
+    int n, total = 0;
+
+    while ((n = Read(buffer, sizeof buffer, ConsoleInput)) > 0)
+	total += n;
+    Exit(total);
+}
@@ -0,0 +1,20 @@
+/* echo.c
+ *	Write the arguments, separated by blanks, to ConsoleOutput.
+ *	Started with SpawnV, e.g. from the shell: "echo hello world".
+ */
+
+#include "syscall.h"
+
+int
+main(int argc, char **argv)
+{
+    int i, len;
+
+    for (i = 1; i < argc; i++) {
+	for (len = 0; argv[i][len] != '\0'; len++)
+	    ;
+	Write(argv[i], len, ConsoleOutput);
+	Write(i < argc - 1 ? " " : "\n", 1, ConsoleOutput);
+    }
+    Exit(0);
+}
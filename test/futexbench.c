@@ -0,0 +1,81 @@
+/* futexbench.c
+ *	Lock contention benchmark for user programs.
+ *
+ *	NumWorkers threads of one address space each add Iterations to a
+ *	shared counter, with the lock held across a read-delay-write
+ *	sequence so that preemption inside the critical section is common.
+ *	Run it with random time slicing (e.g. "nachos -rs 1 -x futexbench")
+ *	and compare the tick counts printed at the end with spinbench,
+ *	which is the same program built with -DYIELD_SPIN: a lock that
+ *	spins on AtomicCas and calls Yield while the lock is held.
+ *
+ *	The last worker to finish exits with the number of lost updates
+ *	(0 = ok).
+ */
+
+#include "syscall.h"
+#include "umutex.h"
+
+#define NumWorkers	3
+#define Iterations	50
+#define Work		20	/* delay loop inside the critical section */
+#define StackGap	200	/* bytes of user stack for each worker */
+
+#ifdef YIELD_SPIN
+int spinLock = 0;
+#define Lock()		while (AtomicCas(&spinLock, 0, 1) != 0) Yield()
+#define Unlock()	AtomicCas(&spinLock, 1, 0)
+#else
+UMutex mutex = UMUTEX_INITIALIZER;
+#define Lock()		UMutexLock(&mutex)
+#define Unlock()	UMutexUnlock(&mutex)
+#endif
+
+int counter = 0;
+int finished = 0;
+
+void
+Worker()
+{
+    int i, j, value, last;
+
+    for (i = 0; i < Iterations; i++) {
+	Lock();
+	value = counter;
+	for (j = 0; j < Work; j++)
+	    ;
+	counter = value + 1;
+	Unlock();
+    }
+    Lock();
+    last = (++finished == NumWorkers);
+    Unlock();
+    if (last)
+	Exit(NumWorkers * Iterations - counter);
+    Exit(0);
+}
+
+/* A forked thread starts out on the stack of its parent, so fork each
+ * worker "depth" gaps further down, where the parent never reaches.
+ */
+void
+ForkAt(int depth)
+{
+    char gap[StackGap];
+
+    gap[0] = 0;
+    if (depth > 1)
+	ForkAt(depth - 1);
+    else
+	Fork(Worker);
+}
+
+int
+main()
+{
+    int i;
+
+    for (i = 1; i < NumWorkers; i++)
+	ForkAt(i);
+    Worker();
+}
@@ -0,0 +1,46 @@
+/* pipetest.c
+ *	Simple program to test pipes between user threads.
+ *
+ *	A forked writer pushes a message through the pipe several times
+ *	over, more than the kernel buffers at once, then closes its end.
+ *	The main thread reads until end of file, and exits with the number
+ *	of bytes that did not come through intact (0 means success).
+ */
+
+#include "syscall.h"
+
+#define Rounds	40
+
+OpenFileId fds[2];
+char message[] = "0123456789abcdef";
+
+void
+writer()
+{
+    int i;
+
+    for (i = 0; i < Rounds; i++)
+	Write(message, 16, fds[1]);
+    Close(fds[1]);
+    Exit(0);
+}
+
+int
+main()
+{
+    char buffer[16];
+    int i, n, total = 0, bad = 0;
+
+    if (Pipe(fds) < 0)
+	Exit(-1);
+    Fork(writer);
+
+    while ((n = Read(buffer, 16, fds[0])) > 0) {
+	for (i = 0; i < n; i++)
+	    if (buffer[i] != message[(total + i) % 16])
+		bad++;
+	total += n;
+    }
+    Close(fds[0]);
+    Exit(bad + (Rounds * 16 - total));
+}
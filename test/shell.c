@@ -1,12 +1,38 @@
 #include "syscall.h"
 
+#define MaxArgs	8
+
+/* Split "line" in place into words separated by blanks, and point
+ * "argv" at them.  Return the number of words.
+ */
+int
+Split(char *line, char **argv)
+{
+    int argc = 0;
+
+    while (argc < MaxArgs) {
+	while (*line == ' ')
+	    *line++ = '\0';
+	if (*line == '\0')
+	    break;
+	argv[argc++] = line;
+	while (*line != '\0' && *line != ' ')
+	    line++;
+    }
+    argv[argc] = 0;
+    return argc;
+}
+
 int
 main()
 {
-    SpaceId newProc;
+    SpaceId newProc, left, right;
     OpenFileId input = ConsoleInput;
     OpenFileId output = ConsoleOutput;
+    OpenFileId fds[2];
     char prompt[2], ch, buffer[60];
+    char *argv[MaxArgs + 1], *argv2[MaxArgs + 1];
+    char *bar;
     int i;
 
     prompt[0] = '-';
@@ -22,14 +48,29 @@ main()
 	
 	    Read(&buffer[i], 1, input); 
 
-	} while( buffer[i++] != '\n' );
+	} while( buffer[i++] != '\n' && i < 59 );
 
 	buffer[--i] = '\0';
 
-	if( i > 0 ) {
-		newProc = Exec(buffer);
+	for (bar = buffer; *bar != '\0' && *bar != '|'; bar++)
+	    ;
+	if (*bar == '\0') {		/* a single command */
+	    if (Split(buffer, argv) > 0) {
+		newProc = SpawnV(argv[0], argv, input, output);
 		Join(newProc);
+	    }
+	} else {			/* "a | b" */
+	    *bar = '\0';
+	    if (Split(buffer, argv) == 0 || Split(bar + 1, argv2) == 0)
+		continue;
+	    if (Pipe(fds) < 0)
+		continue;
+	    left = SpawnV(argv[0], argv, input, fds[1]);
+	    right = SpawnV(argv2[0], argv2, fds[0], output);
+	    Close(fds[0]);		/* the children hold their own ends */
+	    Close(fds[1]);
+	    Join(left);
+	    Join(right);
 	}
     }
 }
-
@@ -0,0 +1,39 @@
+/* shmtest.c
+ *	Simple program to test shared memory segments.
+ *
+ *	The same segment is attached twice, as a producer and a consumer
+ *	view.  Whatever the producer stores must show up in the consumer
+ *	view without any copying, since both map the same physical pages.
+ *	Exit status is the number of words that did not match (0 = ok).
+ */
+
+#include "syscall.h"
+
+#define Key	42
+#define Words	64
+
+int
+main()
+{
+    ShmId id;
+    int *producer, *consumer;
+    int i, bad = 0;
+
+    id = ShmGet(Key, Words * sizeof(int));
+    if (id < 0)
+	Exit(-1);
+    producer = (int *) ShmAttach(id);
+    consumer = (int *) ShmAttach(ShmGet(Key, 0));
+    if (producer == 0 || consumer == 0 || producer == consumer)
+	Exit(-2);
+
+    for (i = 0; i < Words; i++)
+	producer[i] = i * i;
+    for (i = 0; i < Words; i++)
+	if (consumer[i] != i * i)
+	    bad++;
+
+    ShmDetach((char *) producer);
+    ShmDetach((char *) consumer);
+    Exit(bad);
+}
@@ -24,11 +24,44 @@
 	.globl __start
 	.ent	__start
 __start:
+	.set	noreorder	/* keep this exactly 16 bytes long */
 	jal	main
-	move	$4,$0		
+	nop
 	jal	Exit	 /* if we return from main, exit(0) */
+	move	$4,$0	 /* (branch delay slot) */
+	.set	reorder
 	.end __start
 
+/* -------------------------------------------------------------
+ * AtomicCas
+ *	Compare and swap the word at r4: if it holds r5, store r6.
+ *	Return the old value of the word.
+ *
+ *	MIPS I has no atomic instructions, so this is a restartable
+ *	sequence instead: if the thread is switched out anywhere between
+ *	the load and the store, the kernel moves it back to the load
+ *	(see Thread::SaveUserState).  This relies on the sequence being
+ *	at a known address, so it has to come right after __start; the
+ *	addresses of the load and the store are AtomicCasStart and
+ *	AtomicCasStore in syscall.h.
+ * -------------------------------------------------------------
+ */
+
+	.globl AtomicCas
+	.ent	AtomicCas
+AtomicCas:
+	.set	noreorder
+	lw	$2,0($4)	/* AtomicCasStart */
+	nop
+	bne	$2,$5,CasDone
+	nop
+	sw	$6,0($4)	/* AtomicCasStore */
+CasDone:
+	j	$31
+	nop
+	.set	reorder
+	.end AtomicCas
+
 /* -------------------------------------------------------------
  * System call stubs:
  *	Assembly language assist to make system calls to the Nachos kernel.
@@ -130,6 +163,86 @@ Yield:
 	j	$31
 	.end Yield
 
+	.globl Pipe
+	.ent	Pipe
+Pipe:
+	addiu $2,$0,SC_Pipe
+	syscall
+	j	$31
+	.end Pipe
+
+	.globl ShmGet
+	.ent	ShmGet
+ShmGet:
+	addiu $2,$0,SC_ShmGet
+	syscall
+	j	$31
+	.end ShmGet
+
+	.globl ShmAttach
+	.ent	ShmAttach
+ShmAttach:
+	addiu $2,$0,SC_ShmAttach
+	syscall
+	j	$31
+	.end ShmAttach
+
+	.globl ShmDetach
+	.ent	ShmDetach
+ShmDetach:
+	addiu $2,$0,SC_ShmDetach
+	syscall
+	j	$31
+	.end ShmDetach
+
+	.globl FutexWait
+	.ent	FutexWait
+FutexWait:
+	addiu $2,$0,SC_FutexWait
+	syscall
+	j	$31
+	.end FutexWait
+
+	.globl FutexWake
+	.ent	FutexWake
+FutexWake:
+	addiu $2,$0,SC_FutexWake
+	syscall
+	j	$31
+	.end FutexWake
+
+	.globl SpawnV
+	.ent	SpawnV
+SpawnV:
+	addiu $2,$0,SC_SpawnV
+	syscall
+	j	$31
+	.end SpawnV
+
+	.globl AioRead
+	.ent	AioRead
+AioRead:
+	addiu $2,$0,SC_AioRead
+	syscall
+	j	$31
+	.end AioRead
+
+	.globl AioWrite
+	.ent	AioWrite
+AioWrite:
+	addiu $2,$0,SC_AioWrite
+	syscall
+	j	$31
+	.end AioWrite
+
+	.globl AioWait
+	.ent	AioWait
+AioWait:
+	addiu $2,$0,SC_AioWait
+	syscall
+	j	$31
+	.end AioWait
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
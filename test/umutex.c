@@ -0,0 +1,58 @@
+/* umutex.c
+ *	User-level mutual exclusion lock.  See umutex.h.
+ */
+
+#include "syscall.h"
+#include "umutex.h"
+
+/* Store "val" in "*addr", and return what was there before. */
+static int
+Swap(int *addr, int val)
+{
+    int old;
+
+    do
+	old = *addr;
+    while (AtomicCas(addr, old, val) != old);
+    return old;
+}
+
+void
+UMutexInit(UMutex *m)
+{
+    m->state = 0;
+}
+
+int
+UMutexTryLock(UMutex *m)
+{
+    return AtomicCas(&m->state, 0, 1) == 0;
+}
+
+/* Take the lock.  If it is held, mark it as contended (2) and sleep
+ * until it is released; whoever wakes up takes it still marked as
+ * contended, since other threads may be asleep as well.
+ */
+void
+UMutexLock(UMutex *m)
+{
+    int c;
+
+    c = AtomicCas(&m->state, 0, 1);
+    if (c == 0)
+	return;			/* fast path: no system call */
+    if (c != 2)
+	c = Swap(&m->state, 2);
+    while (c != 0) {
+	FutexWait(&m->state, 2);
+	c = Swap(&m->state, 2);
+    }
+}
+
+/* Release the lock, and wake one sleeper if there might be any. */
+void
+UMutexUnlock(UMutex *m)
+{
+    if (Swap(&m->state, 0) == 2)
+	FutexWake(&m->state, 1);
+}
@@ -0,0 +1,27 @@
+/* umutex.h
+ *	A mutual exclusion lock for user programs, built on AtomicCas,
+ *	FutexWait and FutexWake.
+ *
+ *	Taking a free lock or releasing a lock nobody waits for never
+ *	enters the kernel.  The lock word is
+ *		0 -- free
+ *		1 -- held, nobody waiting
+ *		2 -- held, and somebody may be waiting in FutexWait
+ *	so only a release from state 2 has to make a FutexWake system call.
+ */
+
+#ifndef UMUTEX_H
+#define UMUTEX_H
+
+typedef struct {
+    int state;
+} UMutex;
+
+#define UMUTEX_INITIALIZER	{ 0 }
+
+void UMutexInit(UMutex *m);
+void UMutexLock(UMutex *m);
+int UMutexTryLock(UMutex *m);	/* 1 if the lock was taken, 0 if not */
+void UMutexUnlock(UMutex *m);
+
+#endif /* UMUTEX_H */
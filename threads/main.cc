@@ -11,7 +11,10 @@
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+//		-p <nachos file> -r <nachos file> -l -D -t -bm <workload>
+//		-bc <cache sectors>
+//		-ds <fifo|sstf|scan|clook> -dm <hdd|ssd|nvme|zero>
+//		-dn <disks> -dr <stripe|mirror> -at <strict|relatime|noatime>
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
@@ -33,6 +36,15 @@
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -bm benchmarks the file system: seq, random, meta, lookup, mixed
+//	or all; results are the lines starting with BENCH (cf. fstest.cc)
+//    -bc sets the number of sectors in the disk cache (0 turns it off)
+//    -ds picks how waiting disk requests are scheduled (default clook)
+//    -dm picks how long disk requests take (default hdd)
+//    -dn spreads the file system over several disks, DISK.0, DISK.1, ...
+//    -dr picks whether they are striped (the default) or mirrored
+//    -at picks when opening a file updates its access time (default
+//	relatime: only if it was modified since it was last accessed)
 //
 //  NETWORK
 //    -n sets the network reliability
@@ -61,6 +73,7 @@ extern int testnum;
 
 extern void ThreadTest(int n), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *targetPath, char *file), PerformanceTest(void), ChangeDirectory(char *newPath), PrintDirectory();
+extern void Benchmark(char *workload);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
 
@@ -167,6 +180,10 @@ main(int argc, char **argv)
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-bm")) {	// file system benchmark
+	    ASSERT(argc > 1);
+            Benchmark(*(argv + 1));
+	    argCount = 2;
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -260,9 +260,9 @@ RWLock::ReleaseLock()
     mutex->Acquire();
     if(isHeldByWriter)
     {
+        isHeldByWriter = false;		// before anyone wakes up to look
         conLock->Broadcast(mutex);
         mutex->Release();
-        isHeldByWriter = false;
         //printf("%s release the lock\n", currentThread->getName());
         return;
     }
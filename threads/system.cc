@@ -30,11 +30,17 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+InodeTable  *inodeTable;
+Journal     *journal;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
 BitMap *memoryBitmap;
+PipeTable *pipeTable;
+ShmTable *shmTable;
+FutexTable *futexTable;
+AioTable *aioTable;
 #endif
 
 #ifdef NETWORK
@@ -104,6 +110,14 @@ Initialize(int argc, char **argv)
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    int cacheSize = CacheSize;	// sectors in the disk cache
+    DiskPolicy diskPolicy = DiskCLOOK;	// order of waiting disk requests
+    char *diskModel = "hdd";		// how long disk requests take
+    int numDisks = 1;			// disks to spread sectors over,
+    ArrayLayout diskLayout = ArrayStripe;	// and how
+    AtimeMode atimeMode = AtimeRelative;	// when access times change
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -133,6 +147,54 @@ Initialize(int argc, char **argv)
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-bc")) {
+	    ASSERT(argc > 1);
+	    cacheSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ds")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		diskPolicy = DiskFIFO;
+	    else if (!strcmp(*(argv + 1), "sstf"))
+		diskPolicy = DiskSSTF;
+	    else if (!strcmp(*(argv + 1), "scan"))
+		diskPolicy = DiskSCAN;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "clook"));
+		diskPolicy = DiskCLOOK;
+	    }
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dm")) {
+	    ASSERT(argc > 1);
+	    diskModel = *(argv + 1);		// hdd, ssd, nvme or zero
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dn")) {
+	    ASSERT(argc > 1);
+	    numDisks = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dr")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "mirror"))
+		diskLayout = ArrayMirror;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "stripe"));
+		diskLayout = ArrayStripe;
+	    }
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-at")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "strict"))
+		atimeMode = AtimeStrict;
+	    else if (!strcmp(*(argv + 1), "noatime"))
+		atimeMode = AtimeNever;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "relatime"));
+		atimeMode = AtimeRelative;
+	    }
+	    argCount = 2;
+	}
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -169,15 +231,26 @@ Initialize(int argc, char **argv)
     
 #ifdef USER_PROGRAM
     machine = new Machine(debugUserProg);	// this must come first
+    pipeTable = new PipeTable();
+    shmTable = new ShmTable();
+    futexTable = new FutexTable();
+    aioTable = new AioTable();
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", cacheSize, diskPolicy, diskModel,
+							numDisks, diskLayout);
+    inodeTable = new InodeTable();
+    journal = new Journal();
 #endif
 
+#ifdef FILESYS
+    fileSystem = new FileSystem(format, atimeMode);
+#else
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
+#endif
 
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, 10);
@@ -197,6 +270,10 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete aioTable;
+    delete futexTable;
+    delete shmTable;
+    delete pipeTable;
     delete machine;
 #endif
 
@@ -205,7 +282,9 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete inodeTable;			// writes back changed file headers
     delete synchDisk;
+    delete journal;			// already shut down by the file system
 #endif
     
     delete timer;
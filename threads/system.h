@@ -44,8 +44,16 @@ extern List *msgQueue[MAX_MESSAGE_QUEUE];
 #ifdef USER_PROGRAM
 #include "machine.h"
 #include "bitmap.h"
+#include "pipe.h"
+#include "shm.h"
+#include "futex.h"
+#include "aio.h"
 extern Machine* machine;	// user program memory and registers
 extern BitMap *memoryBitmap;
+extern PipeTable *pipeTable;	// pipes between user programs
+extern ShmTable *shmTable;	// shared memory segments
+extern FutexTable *futexTable;	// user-level lock wait queues
+extern AioTable *aioTable;	// asynchronous file I/O requests
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -55,7 +63,11 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "inode.h"
+#include "journal.h"
 extern SynchDisk   *synchDisk;
+extern InodeTable  *inodeTable;	// file headers of the open files
+extern Journal     *journal;	// write-ahead log of metadata changes
 #endif
 
 #ifdef NETWORK
@@ -19,6 +19,9 @@
 #include "switch.h"
 #include "synch.h"
 #include "system.h"
+#ifdef USER_PROGRAM
+#include "syscall.h"
+#endif
 
 #define STACK_FENCEPOST 0xdeadbeef	// this is put at the top of the
 					// execution stack, for detecting 
@@ -48,6 +51,8 @@ Thread::Thread(char* threadName)
 
 #ifdef USER_PROGRAM
     space = NULL;
+    stdIn = ConsoleInput;
+    stdOut = ConsoleOutput;
 #endif
 }
 
@@ -433,6 +438,19 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 void
 Thread::SaveUserState()
 {
+    int pc = machine->ReadRegister(PCReg);
+
+    // Restart an AtomicCas that was cut off half way (see start.s).
+    // Any load still in flight is dropped; the sequence reloads it.
+    // Programs built with an older start.s have other code there.
+    if (space != NULL && space->HasAtomicCas()
+	    && pc > AtomicCasStart && pc <= AtomicCasStore) {
+	DEBUG('t', "Restarting AtomicCas in thread \"%s\"\n", getName());
+	machine->WriteRegister(PCReg, AtomicCasStart);
+	machine->WriteRegister(NextPCReg, AtomicCasStart + 4);
+	machine->WriteRegister(LoadReg, 0);
+	machine->WriteRegister(LoadValueReg, 0);
+    }
     for (int i = 0; i < NumTotalRegs; i++)
 	userRegisters[i] = machine->ReadRegister(i);
 }
@@ -142,6 +142,9 @@ class Thread {
     void RestoreUserState();		// restore user-level register state
     void initUserRegisters();   //to init the userRegisters;
     AddrSpace *space;			// User code this thread is running.
+    int stdIn, stdOut;			// What ConsoleInput and ConsoleOutput
+					// stand for in this thread: the
+					// console, or an inherited pipe end
 #endif
 };
 
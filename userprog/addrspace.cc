@@ -19,6 +19,7 @@
 #include "system.h"
 #include "addrspace.h"
 #include "noff.h"
+#include "syscall.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -45,6 +46,36 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// FindAtomicCas
+// 	Return TRUE if the program has the AtomicCas sequence of start.s
+//	where the kernel expects it: the load at AtomicCasStart and the
+//	store at AtomicCasStore.  A program built with an older start.s
+//	has other code there (Halt and Exit), which must never be moved
+//	back to AtomicCasStart (cf. Thread::SaveUserState).
+//----------------------------------------------------------------------
+
+#define CasLoadWord	0x8c820000	// lw $2,0($4)
+#define CasStoreWord	0xac860000	// sw $6,0($4)
+
+static bool
+FindAtomicCas(OpenFile *executable, NoffHeader *noffH)
+{
+    unsigned int load, store;
+    int offset = noffH->code.inFileAddr + AtomicCasStart
+						- noffH->code.virtualAddr;
+
+    if (noffH->code.virtualAddr > AtomicCasStart
+	    || noffH->code.virtualAddr + noffH->code.size < AtomicCasStore + 4)
+	return FALSE;
+    if (executable->ReadAt((char *)&load, 4, offset) != 4
+	    || executable->ReadAt((char *)&store, 4,
+			offset + AtomicCasStore - AtomicCasStart) != 4)
+	return FALSE;
+    return WordToHost(load) == CasLoadWord
+				&& WordToHost(store) == CasStoreWord;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -65,7 +96,7 @@ SwapHeader (NoffHeader *noffH)
 
 //old version of AddrSpace is stored in lab syscall.
 
-AddrSpace::AddrSpace(OpenFile *executable)
+AddrSpace::AddrSpace(OpenFile *executable, char *swapName)
 {
     NoffHeader noffH;
     unsigned int i, size;
@@ -75,6 +106,9 @@ AddrSpace::AddrSpace(OpenFile *executable)
         (WordToHost(noffH.noffMagic) == NOFFMAGIC))
         SwapHeader(&noffH);
     ASSERT(noffH.noffMagic == NOFFMAGIC);
+    hasAtomicCas = FindAtomicCas(executable, &noffH);
+    table = new PageTable;
+    table->refCount = 1;
 
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
             + UserStackSize;    // we need to increase the size
@@ -84,31 +118,35 @@ AddrSpace::AddrSpace(OpenFile *executable)
         noffH.initData.size, noffH.initData.virtualAddr, noffH.initData.inFileAddr);
     printf("uninitData: size is %d, virtualAddr is %d, inFileAddr is %d\n",
         noffH.uninitData.size, noffH.uninitData.virtualAddr, noffH.uninitData.inFileAddr);
-    numPages = divRoundUp(size, PageSize);
-    printf("file size is %d, numPages is %d\n", size, numPages);    
-    size = numPages * PageSize;
+    table->numPages = divRoundUp(size, PageSize);
+    printf("file size is %d, numPages is %d\n", size, table->numPages);    
+    size = table->numPages * PageSize;
+    initArgc = 0;
+    initArgv = 0;
+    initStack = size - 16;
     printf("new size is %d\n", size);
     DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
-                    numPages, size);
+                    table->numPages, size);
         // first, set up the translation 
 
     int intraFileAddr, virPageNum, offSet, phyPageNum;
     int clearMem = memoryBitmap->NumClear();
 
-    if(numPages <= clearMem)
+    if(table->numPages <= clearMem)
     {
         printf("in Addrspace, numPages is %d, clearMem is %d, so no need to create swapfile\n", 
-            numPages, clearMem);
-        pageTable = new TranslationEntry[numPages];
-        for (i = 0; i < numPages; i++) 
+            table->numPages, clearMem);
+        table->entries = new TranslationEntry[table->numPages];
+        for (i = 0; i < table->numPages; i++) 
         {
-            pageTable[i].virtualPage = i;   // for now, virtual page # = phys page #
-            pageTable[i].physicalPage = memoryBitmap->Find();
-            pageTable[i].valid = TRUE;
-            pageTable[i].use = FALSE;
-            pageTable[i].dirty = FALSE;
-            pageTable[i].readOnly = FALSE; 
-            pageTable[i].hitTimes = 0;
+            table->entries[i].virtualPage = i;   // for now, virtual page # = phys page #
+            table->entries[i].physicalPage = memoryBitmap->Find();
+            table->entries[i].valid = TRUE;
+            table->entries[i].use = FALSE;
+            table->entries[i].dirty = FALSE;
+            table->entries[i].readOnly = FALSE; 
+            table->entries[i].hitTimes = 0;
+            table->entries[i].shared = FALSE;
 
         }
         if (noffH.code.size > 0) 
@@ -118,7 +156,7 @@ AddrSpace::AddrSpace(OpenFile *executable)
             {
                 virPageNum = (noffH.code.virtualAddr + i) / PageSize;
                 offSet = (noffH.code.virtualAddr + i) % PageSize;
-                phyPageNum = pageTable[virPageNum].physicalPage;
+                phyPageNum = table->entries[virPageNum].physicalPage;
                 executable->ReadAt(&(machine->mainMemory[phyPageNum * PageSize + offSet]), 1, intraFileAddr);
                 intraFileAddr++;
             }
@@ -132,7 +170,7 @@ AddrSpace::AddrSpace(OpenFile *executable)
             {
                 virPageNum = (noffH.initData.virtualAddr + i) / PageSize;
                 offSet = (noffH.initData.virtualAddr + i) % PageSize;
-                phyPageNum = pageTable[virPageNum].physicalPage;
+                phyPageNum = table->entries[virPageNum].physicalPage;
                 executable->ReadAt(&(machine->mainMemory[phyPageNum * PageSize + offSet]), 1, intraFileAddr);
                 intraFileAddr++;
             }
@@ -143,31 +181,32 @@ AddrSpace::AddrSpace(OpenFile *executable)
     //on this condition, we should write info on swap zone since there is no enough memory
     else 
     {
-        printf("in Addrspace, clearMem is %d, numPages is %d, so not enough!\n", clearMem, numPages);
-        pageTable = new TranslationEntry[numPages];
-        for (i = 0; i < numPages; i++) 
+        printf("in Addrspace, clearMem is %d, numPages is %d, so not enough!\n", clearMem, table->numPages);
+        table->entries = new TranslationEntry[table->numPages];
+        for (i = 0; i < table->numPages; i++) 
         {
-            pageTable[i].virtualPage = i;   // for now, virtual page # = phys page #
+            table->entries[i].virtualPage = i;   // for now, virtual page # = phys page #
             if(i < clearMem)
             {
-                pageTable[i].physicalPage = memoryBitmap->Find();
-                pageTable[i].valid = TRUE;
+                table->entries[i].physicalPage = memoryBitmap->Find();
+                table->entries[i].valid = TRUE;
             }
             else
             {
-                pageTable[i].physicalPage = -1;
-                pageTable[i].valid = FALSE;
+                table->entries[i].physicalPage = -1;
+                table->entries[i].valid = FALSE;
             }
-            pageTable[i].use = FALSE;
-            pageTable[i].dirty = FALSE;
-            pageTable[i].readOnly = FALSE; 
-            pageTable[i].hitTimes = 0;
+            table->entries[i].use = FALSE;
+            table->entries[i].dirty = FALSE;
+            table->entries[i].readOnly = FALSE; 
+            table->entries[i].hitTimes = 0;
+            table->entries[i].shared = FALSE;
            
         }
 
-        char *fileName = currentThread->getName();
-        int anum = numPages % 11;
-        char singleChar = 'a' + numPages % 26;
+        char *fileName = (swapName != NULL) ? swapName : currentThread->getName();
+        int anum = table->numPages % 11;
+        char singleChar = 'a' + table->numPages % 26;
         char *prefix = new char[anum + 100]; 
         for(i=0; i<anum; i++)
             prefix[i] = singleChar; 
@@ -217,9 +256,9 @@ AddrSpace::AddrSpace(OpenFile *executable)
                 {
                     virPageNum = (noffH.code.virtualAddr + i) / PageSize;
                     offSet = (noffH.code.virtualAddr + i) % PageSize;
-                    if(pageTable[virPageNum].valid)
+                    if(table->entries[virPageNum].valid)
                     {
-                        phyPageNum = pageTable[virPageNum].physicalPage;
+                        phyPageNum = table->entries[virPageNum].physicalPage;
                         executable->ReadAt(&(machine->mainMemory[phyPageNum * PageSize + offSet]), 
                             1, intraFileAddr);
                     }
@@ -235,10 +274,10 @@ AddrSpace::AddrSpace(OpenFile *executable)
                 {
                     virPageNum = (noffH.initData.virtualAddr + i) / PageSize;
                     offSet = (noffH.initData.virtualAddr + i) % PageSize;
-                    if(pageTable[virPageNum].valid)
+                    if(table->entries[virPageNum].valid)
                     {
                         printf("pageTable[%d] is valid, so initData write in\n", virPageNum);
-                        phyPageNum = pageTable[virPageNum].physicalPage;
+                        phyPageNum = table->entries[virPageNum].physicalPage;
                         executable->ReadAt(&(machine->mainMemory[phyPageNum * PageSize + offSet]), 
                             1, intraFileAddr);
                     }
@@ -260,24 +299,47 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
 
 
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Make the address space of a thread forked by a user program: it
+//	runs in the same memory as "parent", so it shares its page table
+//	and swap file.  A segment either of them maps later is seen by
+//	both, and so is a futex (cf. futex.h).
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(const AddrSpace &parent)
+{
+    table = parent.table;
+    table->refCount++;
+    swapFile = parent.swapFile;
+    initArgc = parent.initArgc;
+    initArgv = parent.initArgv;
+    initStack = parent.initStack;
+    hasAtomicCas = parent.hasAtomicCas;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space.  The page table and the frames it
+//	maps go only with the last address space sharing them.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   
-   for(int i=0; i<numPages; i++)
+   shmTable->DetachAll(this);
+   aioTable->ReleaseAll(this);
+   if (--table->refCount > 0)
+       return;
+   for(int i=0; i<table->numPages; i++)
    {
-        if(pageTable[i].valid)
+        if(table->entries[i].valid && !table->entries[i].shared)
         {
-            memoryBitmap->Clear(pageTable[i].physicalPage);
+            memoryBitmap->Clear(table->entries[i].physicalPage);
         }
    }
    
-   delete pageTable;
-
+   delete [] table->entries;
+   delete table;
 }
 
 //----------------------------------------------------------------------
@@ -307,12 +369,92 @@ AddrSpace::InitRegisters()
 
    // Set the stack register to the end of the address space, where we
    // allocated the stack; but subtract off a bit, to make sure we don't
-   // accidentally reference off the end!
-    machine->WriteRegister(StackReg, numPages * PageSize - 16);
-    DEBUG('a', "Initializing stack register to %d\n", numPages * PageSize - 16);
+   // accidentally reference off the end!  PushArgs may have moved it
+   // down past main's arguments.
+    machine->WriteRegister(StackReg, initStack);
+    DEBUG('a', "Initializing stack register to %d\n", initStack);
+
+    machine->WriteRegister(4, initArgc);
+    machine->WriteRegister(5, initArgv);
     //printf("in addrspace initregisters, successfully returned\n");
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::PushArgs
+// 	Copy "argv" onto the top of the user stack, so that the program
+//	starts as main(argc, argv).  The strings go at the very top, then
+//	the array of pointers to them (ending with a NULL pointer), then
+//	the usual 16 bytes the MIPS calling convention leaves free for
+//	the callee.  Must be called before InitRegisters.
+//
+//	Return FALSE if the arguments would take up more than half of
+//	the stack.
+//
+//	"argc" -- number of arguments
+//	"argv" -- the arguments, as kernel strings
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PushArgs(int argc, char **argv)
+{
+    int sp = table->numPages * PageSize - 16;
+    int *userArgv = new int[argc + 1];
+    int i, len, word;
+
+    for (i = 0, len = 0; i < argc; i++)
+	len += strlen(argv[i]) + 1 + 4;
+    if (len + 4 > UserStackSize / 2) {
+	delete [] userArgv;
+	return FALSE;
+    }
+
+    for (i = argc - 1; i >= 0; i--) {
+	len = strlen(argv[i]) + 1;
+	sp -= len;
+	CopyIn(sp, argv[i], len);
+	userArgv[i] = sp;
+    }
+    userArgv[argc] = 0;
+    sp -= sp % 4;
+    sp -= (argc + 1) * 4;
+    for (i = 0; i <= argc; i++) {
+	word = WordToMachine(userArgv[i]);
+	CopyIn(sp + i * 4, (char *) &word, 4);
+    }
+    delete [] userArgv;
+
+    initArgc = argc;
+    initArgv = sp;
+    initStack = sp - 16;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyIn
+// 	Copy "numBytes" bytes from the kernel into this address space at
+//	"virtAddr".  The address space need not be the one running, so
+//	this goes through our own page table rather than the machine's:
+//	a page that is in memory is written directly, and a page that is
+//	not is written to the swap file it will be paged in from.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::CopyIn(int virtAddr, char *from, int numBytes)
+{
+    for (int i = 0; i < numBytes; i++) {
+	int vpn = (virtAddr + i) / PageSize;
+	int offset = (virtAddr + i) % PageSize;
+
+	ASSERT(vpn < table->numPages);
+	if (table->entries[vpn].valid) {
+	    machine->mainMemory[table->entries[vpn].physicalPage * PageSize + offset]
+				= from[i];
+	    table->entries[vpn].dirty = TRUE;
+	} else
+	    swapFile->WriteAt(&from[i], 1, virtAddr + i);
+    }
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::SaveState
 // 	On a context switch, save any machine state, specific
@@ -334,8 +476,8 @@ void AddrSpace::SaveState()
 
 void AddrSpace::RestoreState() 
 {
-    machine->pageTable = pageTable;
-    machine->pageTableSize = numPages;
+    machine->pageTable = table->entries;
+    machine->pageTableSize = table->numPages;
 
     // printf("in restorestate, the new pageTable situation is :\n");
     // printf("there are %d table entries in all\n", numPages);
@@ -354,11 +496,11 @@ void
 AddrSpace::Suspend()
 {
     currentThread->Suspend();
-    for(int i=0; i<numPages; i++)
+    for(int i=0; i<table->numPages; i++)
     {
-        if(pageTable[i].valid)
+        if(table->entries[i].valid && !table->entries[i].shared)
         {
-            memoryBitmap->Clear(pageTable[i].physicalPage);
+            memoryBitmap->Clear(table->entries[i].physicalPage);
         }
     }
 }
@@ -366,9 +508,88 @@ AddrSpace::Suspend()
 void 
 AddrSpace::Print()
 {
-    printf("in this AddrSpace, the numPages is %d\n", numPages);
-    for(int i=0; i<numPages; i++)
+    printf("in this AddrSpace, the numPages is %d\n", table->numPages);
+    for(int i=0; i<table->numPages; i++)
         printf("pageTable[%d] virtualPage is %d, physicalPage is %d\n", 
-            i, pageTable[i].virtualPage, pageTable[i].physicalPage);
+            i, table->entries[i].virtualPage, table->entries[i].physicalPage);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MapShared
+// 	Map the physical pages "frames" of a shared memory segment into
+//	"count" consecutive virtual pages, and return the first of them.
+//	The stack stays where it was; segments live above it.  Pages
+//	left behind by a segment that was detached are used again if
+//	there are enough of them in a row; otherwise the page table grows.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::MapShared(int *frames, int count)
+{
+    int firstPage = -1;
+
+    for (int i = 0; i + count <= table->numPages && firstPage == -1; i++)
+    {
+        int j;
+
+        for (j = i; j < i + count; j++)
+            if (table->entries[j].valid || !table->entries[j].shared)
+                break;			// in use, or not a detached page
+        if (j == i + count)
+            firstPage = i;
+    }
+    if (firstPage == -1)
+    {
+        TranslationEntry *newTable = new TranslationEntry[table->numPages + count];
+
+        for (int i = 0; i < table->numPages; i++)
+            newTable[i] = table->entries[i];
+        delete [] table->entries;
+        table->entries = newTable;
+        firstPage = table->numPages;
+        table->numPages += count;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        table->entries[firstPage + i].virtualPage = firstPage + i;
+        table->entries[firstPage + i].physicalPage = frames[i];
+        table->entries[firstPage + i].valid = TRUE;
+        table->entries[firstPage + i].use = FALSE;
+        table->entries[firstPage + i].dirty = FALSE;
+        table->entries[firstPage + i].readOnly = FALSE;
+        table->entries[firstPage + i].hitTimes = 0;
+        table->entries[firstPage + i].shared = TRUE;
+    }
+
+    if (currentThread->space != NULL && currentThread->space->table == table)
+        RestoreState();
+    machine->cleanTlb();
+    return firstPage;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::UnmapShared
+// 	Remove the mapping of a shared memory segment set up by
+//	MapShared.  The frames belong to the segment, so they are not
+//	freed here.  The page table entries are left invalid but still
+//	marked shared: touching them is an address error (cf.
+//	Machine::Translate), never a page fault, and MapShared can use
+//	them again.  Such pages at the end of the table are dropped.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::UnmapShared(int firstPage, int count)
+{
+    for (int i = firstPage; i < firstPage + count; i++)
+    {
+        ASSERT(table->entries[i].shared);
+        table->entries[i].valid = FALSE;
+        table->entries[i].physicalPage = -1;
+    }
+    while (table->numPages > 0 && table->entries[table->numPages - 1].shared
+                && !table->entries[table->numPages - 1].valid)
+        table->numPages--;
+    if (currentThread->space != NULL && currentThread->space->table == table)
+        RestoreState();
+    machine->cleanTlb();
+}
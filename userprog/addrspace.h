@@ -18,29 +18,55 @@
 
 #define UserStackSize		1024 	// increase this as necessary!
 
+// The following class defines a page table.  Threads made by Fork run
+// in their parent's memory, so their address spaces share one.
+
+class PageTable {
+  public:
+    TranslationEntry *entries;		// one per virtual page
+    unsigned int numPages;		// number of entries
+    int refCount;			// address spaces sharing it
+};
+
 class AddrSpace {
   public:
-    AddrSpace(OpenFile *executable);	// Create an address space,
+    AddrSpace(OpenFile *executable, char *swapName = NULL);
+					// Create an address space,
 					// initializing it with the program
 					// stored in the file "executable"
+    AddrSpace(const AddrSpace &parent);	// Address space of a thread
+					// forked by "parent"'s program
     ~AddrSpace();			// De-allocate an address space
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
+    bool PushArgs(int argc, char **argv);	// Copy an argument vector onto
+					// the stack, for main(argc, argv)
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
     int getStackReg();    //returns the StackReg info
     OpenFile *swapFile;
-    int getNumPages(){return numPages;};
+    int getNumPages(){return table->numPages;};
     void Suspend();
     void Print();
+    int MapShared(int *frames, int count);	// Map a shared memory segment
+    void UnmapShared(int firstPage, int count);	// and take it away again
+    bool HasAtomicCas() { return hasAtomicCas; }
+					// Was the program built with the
+					// AtomicCas of start.s?
+    PageTable *GetPageTable() { return table; }
 
   private:
-    TranslationEntry *pageTable;	// Assume linear page table translation
+    PageTable *table;			// Assume linear page table translation
 					// for now!
-    unsigned int numPages;		// Number of pages in the virtual 
-					// address space
+    int initArgc, initArgv;		// main's arguments, set up by PushArgs
+    int initStack;			// initial stack pointer
+    bool hasAtomicCas;			// AtomicCas is at AtomicCasStart
+
+    void CopyIn(int virtAddr, char *from, int numBytes);
+					// Write into this address space,
+					// whether or not it is running
     //char userFileName[128];
 };
 
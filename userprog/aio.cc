@@ -0,0 +1,239 @@
+// aio.cc
+//	Routines to implement asynchronous file I/O.  See aio.h.
+//
+//	The table is protected by a lock; AioWait sleeps on a condition
+//	variable that the I/O thread broadcasts after each request.  The
+//	I/O thread itself does the transfers without holding the lock, so
+//	that new requests can be queued while the disk is busy.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "aio.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// AioServe
+// 	Dummy function because C++ can't fork a member function.
+//----------------------------------------------------------------------
+
+static void
+AioServe(int table)
+{
+    ((AioTable *) table)->Serve();
+}
+
+//----------------------------------------------------------------------
+// AioTable::AioTable
+// 	Initialize the table; initially there are no requests.  The I/O
+//	thread is only forked once the first request comes in.
+//----------------------------------------------------------------------
+
+AioTable::AioTable()
+{
+    for (int i = 0; i < MaxAioRequests; i++)
+	requests[i].inUse = FALSE;
+    pending = new SynchList;
+    lock = new Lock("aio lock");
+    finished = new Condition("aio finished");
+    started = FALSE;
+}
+
+//----------------------------------------------------------------------
+// AioTable::~AioTable
+// 	De-allocate the table, when Nachos is halting.  Requests that were
+//	never waited for are thrown away.
+//----------------------------------------------------------------------
+
+AioTable::~AioTable()
+{
+    for (int i = 0; i < MaxAioRequests; i++)
+	if (requests[i].inUse)
+	    delete [] requests[i].data;
+    delete pending;
+    delete lock;
+    delete finished;
+}
+
+//----------------------------------------------------------------------
+// AioTable::Submit
+// 	Queue a transfer for the I/O thread, and return its ticket.
+//	For a write, the data is copied out of user memory now.  Return
+//	-1 if "size" is out of range or too many requests are outstanding.
+//
+//	"writing" -- TRUE for AioWrite, FALSE for AioRead
+//	"fileId" -- the OpenFileId to transfer to or from
+//	"userBuffer" -- the user address of the data
+//	"size" -- the number of bytes to transfer
+//----------------------------------------------------------------------
+
+int
+AioTable::Submit(bool writing, int fileId, int userBuffer, int size)
+{
+    AioRequest *req = NULL;
+    int ticket, value;
+
+    if (size < 0 || size > MaxAioSize)
+	return -1;
+
+    lock->Acquire();
+    for (ticket = 0; ticket < MaxAioRequests; ticket++)
+	if (!requests[ticket].inUse) {
+	    req = &requests[ticket];
+	    break;
+	}
+    if (req == NULL) {
+	lock->Release();
+	return -1;
+    }
+    req->inUse = TRUE;
+    req->done = FALSE;
+    req->orphaned = FALSE;
+    lock->Release();
+
+    req->writing = writing;
+    req->fileId = fileId;
+    req->size = size;
+    req->userBuffer = userBuffer;
+    req->space = currentThread->space;
+    req->data = new char[size];
+    req->result = -1;
+    if (writing)
+	for (int i = 0; i < size; i++) {
+	    while (!machine->ReadMem(userBuffer + i, 1, &value))
+		;		// the page fault is handled, try again
+	    req->data[i] = (char) value;
+	}
+
+    if (!started) {
+	Thread *t = new Thread("aio worker");
+
+	started = TRUE;
+	t->Fork(AioServe, (int) this);
+    }
+    DEBUG('a', "Aio ticket %d: %s %d bytes, file %d\n", ticket,
+			writing ? "write" : "read", size, fileId);
+    pending->Append(req);
+    return ticket;
+}
+
+//----------------------------------------------------------------------
+// AioTable::Wait
+// 	Return the result of request "ticket": the number of bytes
+//	transferred, or -1 on error.  For a read, the data is copied into
+//	the user buffer first.  Once its result has been returned, the
+//	ticket is no longer valid.
+//
+//	If "poll" is TRUE and the request is still in progress, return
+//	AioPending at once instead of waiting.  Only the address space
+//	that made a request may wait for it.
+//----------------------------------------------------------------------
+
+int
+AioTable::Wait(int ticket, bool poll)
+{
+    AioRequest *req;
+    int result;
+
+    if (ticket < 0 || ticket >= MaxAioRequests)
+	return -1;
+    req = &requests[ticket];
+
+    lock->Acquire();
+    if (!req->inUse || req->space != currentThread->space) {
+	lock->Release();
+	return -1;
+    }
+    while (!req->done) {
+	if (poll) {
+	    lock->Release();
+	    return AioPending;
+	}
+	finished->Wait(lock);
+    }
+    lock->Release();
+
+    result = req->result;
+    if (!req->writing)
+	for (int i = 0; i < result; i++)
+	    machine->WriteMem(req->userBuffer + i, 1, req->data[i]);
+    delete [] req->data;
+
+    lock->Acquire();
+    req->inUse = FALSE;
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// AioTable::ReleaseAll
+// 	Give up every request made by "space", because it is going away
+//	and nobody will wait for them.  Finished requests are freed now;
+//	the I/O thread frees the ones still queued or in progress once
+//	it is done with them.
+//----------------------------------------------------------------------
+
+void
+AioTable::ReleaseAll(AddrSpace *space)
+{
+    lock->Acquire();
+    for (int i = 0; i < MaxAioRequests; i++) {
+	AioRequest *req = &requests[i];
+
+	if (!req->inUse || req->orphaned || req->space != space)
+	    continue;
+	if (req->done) {
+	    delete [] req->data;
+	    req->inUse = FALSE;
+	} else
+	    req->orphaned = TRUE;
+	req->space = NULL;
+	DEBUG('a', "Aio ticket %d released\n", i);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// AioTable::Serve
+// 	Body of the I/O thread: forever take the oldest queued request,
+//	do the transfer, and wake up anybody waiting for it.  A request
+//	whose address space has gone away is freed instead.
+//----------------------------------------------------------------------
+
+void
+AioTable::Serve()
+{
+    AioRequest *req;
+
+    for (;;) {
+	req = (AioRequest *) pending->Remove();
+
+	if (pipeTable->IsPipe(req->fileId)) {
+	    if (req->writing)
+		req->result = pipeTable->Write(req->fileId, req->data, req->size);
+	    else
+		req->result = pipeTable->Read(req->fileId, req->data, req->size);
+	} else {
+#ifndef FILESYS_STUB
+	    if (req->writing) {
+		fileSystem->SysCallWrite(req->data, req->size, req->fileId);
+		req->result = req->size;
+	    } else
+		req->result = fileSystem->SysCallRead(req->data, req->size,
+							req->fileId);
+#endif
+	}
+
+	DEBUG('a', "Aio request done, result %d\n", req->result);
+	lock->Acquire();
+	req->done = TRUE;
+	if (req->orphaned) {
+	    delete [] req->data;
+	    req->inUse = FALSE;
+	} else
+	    finished->Broadcast(lock);
+	lock->Release();
+    }
+}
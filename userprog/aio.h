@@ -0,0 +1,76 @@
+// aio.h
+//	Data structures for asynchronous file I/O from user programs.
+//
+//	AioRead and AioWrite do not do the transfer themselves: they fill
+//	in a request, hand it to a kernel I/O thread, and return a ticket
+//	at once.  The I/O thread does the transfers one at a time, in the
+//	order they were asked for, so the file position moves just as it
+//	would have with Read and Write.  Meanwhile the user program keeps
+//	running, and collects the result later with AioWait.
+//
+//	The data of an AioWrite is copied out of user memory when the
+//	request is made, so the program may reuse its buffer right away.
+//	The data of an AioRead is kept in the kernel until AioWait, which
+//	copies it into the buffer named in the request.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef AIO_H
+#define AIO_H
+
+#include "copyright.h"
+#include "synch.h"
+#include "synchlist.h"
+
+#define MaxAioRequests 	16	// requests outstanding at once
+#define MaxAioSize 	1024	// largest single transfer, in bytes
+#define AioPending 	-2	// AioWait(ticket, TRUE): not done yet
+
+class AddrSpace;
+
+// The following class defines one outstanding request.  The ticket
+// handed to the user program is the request's index in the table.
+
+class AioRequest {
+  public:
+    bool inUse;			// Is this slot a live request?
+    bool done;			// Has the I/O thread finished with it?
+    bool orphaned;		// Did its address space go away first?
+    bool writing;		// AioWrite rather than AioRead
+    int fileId;			// OpenFileId to transfer to or from
+    int size;			// bytes asked for
+    int userBuffer;		// where AioWait puts the data of a read
+    AddrSpace *space;		// who asked; only they may wait for it
+    char *data;			// kernel copy of the data
+    int result;			// bytes transferred, or -1
+};
+
+// The following class defines the table of outstanding requests, and
+// the I/O thread that serves them.
+
+class AioTable {
+  public:
+    AioTable();
+    ~AioTable();
+
+    int Submit(bool writing, int fileId, int userBuffer, int size);
+				// Queue a request for the current
+				// thread; return its ticket, or -1
+    int Wait(int ticket, bool poll);	// Wait for a request to finish and
+				// return its result; with "poll", return
+				// AioPending instead of waiting
+    void ReleaseAll(AddrSpace *space);	// Called when "space" goes away
+
+    void Serve();		// Body of the I/O thread
+
+  private:
+    AioRequest requests[MaxAioRequests];
+    SynchList *pending;		// requests the I/O thread has yet to do
+    Lock *lock;			// protects the table
+    Condition *finished;	// signalled whenever a request is done
+    bool started;		// Has the I/O thread been forked yet?
+};
+
+#endif // AIO_H
@@ -22,8 +22,12 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    numClear = numBits;
+    hint = 0;
+    firstDirty = numWords;
+    lastDirty = -1;
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +37,7 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
 }
 
 //----------------------------------------------------------------------
@@ -47,7 +51,11 @@ void
 BitMap::Mark(int which) 
 { 
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    if (!Test(which)) {
+	map[which / BitsInWord] |= 1 << (which % BitsInWord);
+	numClear--;
+	Touch(which / BitsInWord);
+    }
 }
     
 //----------------------------------------------------------------------
@@ -61,7 +69,11 @@ void
 BitMap::Clear(int which) 
 {
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (Test(which)) {
+	map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+	numClear++;
+	Touch(which / BitsInWord);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -82,40 +94,178 @@ BitMap::Test(int which)
 	return FALSE;
 }
 
+//----------------------------------------------------------------------
+// BitMap::NextClear
+// 	Return the first clear bit at or after "from", or numBits if
+//	there is none.  Words with every bit set are skipped whole.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int from)
+{
+    int w = from / BitsInWord;
+    unsigned int bits;
+
+    if (from >= numBits)
+	return numBits;
+    bits = ~map[w] & (~0u << (from % BitsInWord));
+    while (bits == 0) {
+	if (++w == numWords)
+	    return numBits;
+	bits = ~map[w];
+    }
+    from = w * BitsInWord + __builtin_ctz(bits);
+    return (from < numBits) ? from : numBits;
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextSet
+// 	Return the first set bit at or after "from", or numBits if
+//	there is none.  Words with every bit clear are skipped whole.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextSet(int from)
+{
+    int w = from / BitsInWord;
+    unsigned int bits;
+
+    if (from >= numBits)
+	return numBits;
+    bits = map[w] & (~0u << (from % BitsInWord));
+    while (bits == 0) {
+	if (++w == numWords)
+	    return numBits;
+	bits = map[w];
+    }
+    from = w * BitsInWord + __builtin_ctz(bits);
+    return (from < numBits) ? from : numBits;
+}
+
 //----------------------------------------------------------------------
 // BitMap::Find
-// 	Return the number of the first bit which is clear.
+// 	Return the number of a bit which is clear.
 //	As a side effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
+//	The search starts at the word last allocated from, rather than
+//	at bit 0, so that the allocated words at the front of the map
+//	are not looked at over and over again.
+//
 //	If no bits are clear, return -1.
 //----------------------------------------------------------------------
 
-int 
-BitMap::Find() 
+int
+BitMap::Find()
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    if (numClear == 0)
+	return -1;
+    for (int i = 0; i < numWords; i++) {
+	int w = (hint + i) % numWords;
+	int which;
+
+	if (map[w] == ~0u)
+	    continue;
+	which = w * BitsInWord + __builtin_ctz(~map[w]);
+	if (which < numBits) {
+	    Mark(which);
+	    hint = w;
+	    return which;
 	}
+    }
     return -1;
 }
 
 //----------------------------------------------------------------------
-// BitMap::NumClear
-// 	Return the number of clear bits in the bitmap.
-//	(In other words, how many bits are unallocated?)
+// BitMap::RunIn
+// 	Look for "wanted" consecutive clear bits starting between "lo"
+//	and "hi" (not included), and return the first of them, or -1.
+//	The first clear run found that is too short is noted in "first"
+//	and "firstLen", unless "first" is already set.  No bits are set.
 //----------------------------------------------------------------------
 
-int 
-BitMap::NumClear() 
+int
+BitMap::RunIn(int lo, int hi, int wanted, int *first, int *firstLen)
 {
-    int count = 0;
+    for (int start = NextClear(lo); start < hi; ) {
+	int end = NextSet(start);
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
-    return count;
+	if (end - start >= wanted)
+	    return start;
+	if (*first == -1) {
+	    *first = start;
+	    *firstLen = end - start;
+	}
+	start = NextClear(end);
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find "wanted" consecutive clear bits and set them.  Return the
+//	first of them, or -1 if there is no such run.  Like Find, the
+//	search starts where the last allocation was made.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int wanted)
+{
+    int near = hint * BitsInWord;
+    int first = -1, firstLen;
+    int start;
+
+    if (wanted <= 0 || wanted > numClear)
+	return -1;
+    start = RunIn(near, numBits, wanted, &first, &firstLen);
+    if (start == -1)
+	start = RunIn(0, near, wanted, &first, &firstLen);
+    if (start == -1)
+	return -1;
+    for (int i = 0; i < wanted; i++)
+	Mark(start + i);
+    hint = (start + wanted - 1) / BitsInWord;
+    return start;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find a run of consecutive clear bits and set them, for allocating
+//	contiguous disk sectors.  The search starts at bit "near" and wraps
+//	around the end of the map.
+//
+//	The first run of at least "wanted" clear bits is used, if there is
+//	one; otherwise the first clear run of any length.  At most "wanted"
+//	bits are set.  Return the first bit of the run, and its length in
+//	"length"; if no bits are clear, return -1.
+//
+//	"near" -- where to start looking, typically just past the last
+//		sector already allocated
+//	"wanted" -- how many bits the caller would like
+//	"length" -- how many bits were set
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int near, int wanted, int *length)
+{
+    int first = -1, firstLen = 0;	// first clear run of any length
+    int start;
+
+    if (near < 0 || near >= numBits)
+	near = 0;
+    start = RunIn(near, numBits, wanted, &first, &firstLen);
+    if (start == -1)
+	start = RunIn(0, near, wanted, &first, &firstLen);
+    if (start != -1) {
+	first = start;
+	firstLen = wanted;
+    }
+    if (first == -1)
+	return -1;
+    for (int i = 0; i < firstLen; i++)
+	Mark(first + i);
+    *length = firstLen;
+    return first;
 }
 
 //----------------------------------------------------------------------
@@ -142,13 +292,21 @@ BitMap::Print()
 // BitMap::FetchFromFile
 // 	Initialize the contents of a bitmap from a Nachos file.
 //
-//	"file" is the place to read the bitmap from
+//	"file" is the place to read the bitmap from.  The bits past the
+//	end of the map are never set, so the clear bits can be counted a
+//	word at a time.
 //----------------------------------------------------------------------
 
 void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    numClear = numBits;
+    for (int i = 0; i < numWords; i++)
+	numClear -= __builtin_popcount(map[i]);
+    hint = 0;
+    firstDirty = numWords;
+    lastDirty = -1;
 }
 
 //----------------------------------------------------------------------
@@ -163,4 +321,42 @@ BitMap::WriteBack(OpenFile *file)
 {
    //printf("writeback in bitmap\n");
    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+   firstDirty = numWords;
+   lastDirty = -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::Flush
+// 	Store the words of a bitmap that have changed since it was last
+//	read or written into a Nachos file, which must already hold the
+//	rest of it.  Nothing is written if nothing changed.
+//
+//	"file" is the place to write the bitmap to
+//----------------------------------------------------------------------
+
+void
+BitMap::Flush(OpenFile *file)
+{
+    if (firstDirty > lastDirty)
+	return;
+    file->WriteAt((char *)&map[firstDirty],
+		(lastDirty - firstDirty + 1) * sizeof(unsigned),
+		firstDirty * sizeof(unsigned));
+    firstDirty = numWords;
+    lastDirty = -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::Touch
+// 	Note that word "w" has changed, and must be written by the next
+//	Flush.
+//----------------------------------------------------------------------
+
+void
+BitMap::Touch(int w)
+{
+    if (w < firstDirty)
+	firstDirty = w;
+    if (w > lastDirty)
+	lastDirty = w;
 }
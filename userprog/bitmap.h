@@ -3,7 +3,9 @@
 //	can be either on or off.
 //
 //	Represented as an array of unsigned integers, on which we do
-//	modulo arithmetic to find the bit we are interested in.
+//	modulo arithmetic to find the bit we are interested in.  Searches
+//	look at a whole word at a time, so that an all-ones word of
+//	allocated bits is skipped with one comparison.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -43,7 +45,14 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
-    int NumClear();		// Return the number of clear bits
+    int FindRun(int wanted);	// Find and set "wanted" consecutive clear
+				// bits; return the first, or -1
+    int FindRun(int near, int wanted, int *length);
+				// Find and set a run of clear bits,
+				// preferably "wanted" long, at or after
+				// "near"; return its first bit, or -1
+    int NumClear() { return numClear; }
+				// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
     
@@ -51,6 +60,8 @@ class BitMap {
     // write the bitmap to a file
     void FetchFrom(OpenFile *file); 	// fetch contents from disk 
     void WriteBack(OpenFile *file); 	// write contents to disk
+    void Flush(OpenFile *file);		// write the words changed since
+					// the last FetchFrom/WriteBack/Flush
 
   private:
     int numBits;			// number of bits in the bitmap
@@ -59,6 +70,20 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    int numClear;			// number of clear bits
+    int hint;				// word to start the next search at:
+					// the one last allocated from
+    int firstDirty, lastDirty;		// words changed since last written;
+					// none if firstDirty > lastDirty
+
+    int NextClear(int from);		// First clear bit at or after "from",
+					// or numBits if there is none
+    int NextSet(int from);		// First set bit at or after "from",
+					// or numBits if there is none
+    void Touch(int w);			// Word "w" has changed
+    int RunIn(int lo, int hi, int wanted, int *first, int *firstLen);
+					// Look for "wanted" clear bits from
+					// [lo, hi) on; note the first shorter run
 };
 
 #endif // BITMAP_H
@@ -49,7 +49,13 @@
 //	are in machine.h.
 //----------------------------------------------------------------------
 
+#define MaxSpawnArgs	8	// most arguments SpawnV passes on
+#define MaxArgLen	64	// longest argument (or file name) it copies
+
 void forkProc(int funcAddr);
+void spawnProc(int arg);
+static char *ReadUserString(int baseAddr);
+static void ExitProgram(int status);
 
 void
 ExceptionHandler(ExceptionType which)
@@ -131,6 +137,26 @@ ExceptionHandler(ExceptionType which)
       printf("syscall close called\n");
       int fileId = machine->ReadRegister(4);
 
+      if(fileId == ConsoleInput && currentThread->stdIn != ConsoleInput)
+      {
+        pipeTable->Close(currentThread->stdIn);
+        currentThread->stdIn = ConsoleInput;
+        machine->AddPC();
+        return;
+      }
+      if(fileId == ConsoleOutput && currentThread->stdOut != ConsoleOutput)
+      {
+        pipeTable->Close(currentThread->stdOut);
+        currentThread->stdOut = ConsoleOutput;
+        machine->AddPC();
+        return;
+      }
+      if(pipeTable->IsPipe(fileId))
+      {
+        pipeTable->Close(fileId);
+        machine->AddPC();
+        return;
+      }
 #ifdef FILESYS_STUB
 
 #else
@@ -151,6 +177,21 @@ ExceptionHandler(ExceptionType which)
       printf("in write syscall, size is %d, fileId is %d\n", size, fileId);
       int readValue;
       int count = 0;
+      if(fileId == ConsoleOutput)
+        fileId = currentThread->stdOut;
+      if(pipeTable->IsPipe(fileId))
+      {
+        char *content = new char[size];
+        for(int i=0; i<size; i++)
+        {
+          machine->ReadMem(baseAddr + i, 1, &readValue);
+          content[i] = (char)readValue;
+        }
+        pipeTable->Write(fileId, content, size);
+        delete [] content;
+        machine->AddPC();
+        return;
+      }
       do{
         machine->ReadMem(baseAddr++, 1, &readValue);
         count++;
@@ -179,6 +220,18 @@ ExceptionHandler(ExceptionType which)
       int fileId = machine->ReadRegister(6);
       int count = 0;
       char *temp = new char[size];
+      if(fileId == ConsoleInput)
+        fileId = currentThread->stdIn;
+      if(pipeTable->IsPipe(fileId))
+      {
+        count = pipeTable->Read(fileId, temp, size);
+        for(int i=0; i<count; i++)
+          machine->WriteMem(baseAddr+i, 1, temp[i]);
+        delete [] temp;
+        machine->WriteRegister(2, count);
+        machine->AddPC();
+        return;
+      }
       //OpenFile *openfile = new OpenFile(fileId);
       //count = openfile->Read(temp, size);
 #ifdef FILESYS_STUB
@@ -264,8 +317,13 @@ ExceptionHandler(ExceptionType which)
     {
       int retVal = machine->ReadRegister(4);
       printf("syscall exit called, the procedure exited with status %d\n", retVal);
-      currentThread->Finish();
-      machine->AddPC();
+      ExitProgram(retVal);
+    }
+    else if(which == AddressErrorException || which == BusErrorException)
+    {
+      printf("bad address 0x%x, the procedure is killed\n",
+        machine->ReadRegister(BadVAddrReg));
+      ExitProgram(-1);
     }
 
     else if(which == SyscallException && type == SC_Fork)
@@ -279,6 +337,10 @@ ExceptionHandler(ExceptionType which)
       space = new AddrSpace(*currentThread->space);
       thread = new Thread("forked");
       thread->space = space;
+      thread->stdIn = currentThread->stdIn;
+      thread->stdOut = currentThread->stdOut;
+      pipeTable->Dup(thread->stdIn, thread);
+      pipeTable->Dup(thread->stdOut, thread);
       space->SaveState();
 
       int* currentState = new int[NumTotalRegs];
@@ -298,6 +360,156 @@ ExceptionHandler(ExceptionType which)
       currentThread->Yield();
       machine->AddPC();
     }
+    else if(which == SyscallException && type == SC_Pipe)
+    {
+      printf("syscall pipe called\n");
+      int fdsAddr = machine->ReadRegister(4);
+      int readFd, writeFd;
+      int retVal = -1;
+
+      if(pipeTable->Create(&readFd, &writeFd))
+      {
+        machine->WriteMem(fdsAddr, 4, readFd);
+        machine->WriteMem(fdsAddr + 4, 4, writeFd);
+        retVal = 0;
+      }
+      machine->WriteRegister(2, retVal);
+      machine->AddPC();
+    }
+    else if(which == SyscallException && type == SC_ShmGet)
+    {
+      printf("syscall shmget called\n");
+      int key = machine->ReadRegister(4);
+      int size = machine->ReadRegister(5);
+      machine->WriteRegister(2, shmTable->Get(key, size, currentThread->space));
+      machine->AddPC();
+    }
+    else if(which == SyscallException && type == SC_ShmAttach)
+    {
+      printf("syscall shmattach called\n");
+      int id = machine->ReadRegister(4);
+      int addr = shmTable->Attach(id, currentThread->space);
+      if(addr < 0)
+        addr = 0;
+      machine->WriteRegister(2, addr);
+      machine->AddPC();
+    }
+    else if(which == SyscallException && type == SC_ShmDetach)
+    {
+      printf("syscall shmdetach called\n");
+      int addr = machine->ReadRegister(4);
+      bool success = shmTable->Detach(addr, currentThread->space);
+      machine->WriteRegister(2, success ? 0 : -1);
+      machine->AddPC();
+    }
+    else if(which == SyscallException && type == SC_FutexWait)
+    {
+      int addr = machine->ReadRegister(4);
+      int expected = machine->ReadRegister(5);
+      DEBUG('a', "syscall futexwait called on 0x%x\n", addr);
+      machine->WriteRegister(2, futexTable->Wait(addr, expected));
+      machine->AddPC();
+    }
+    else if(which == SyscallException && type == SC_FutexWake)
+    {
+      int addr = machine->ReadRegister(4);
+      int count = machine->ReadRegister(5);
+      DEBUG('a', "syscall futexwake called on 0x%x\n", addr);
+      machine->WriteRegister(2, futexTable->Wake(addr, count));
+      machine->AddPC();
+    }
+    else if(which == SyscallException && 
+            (type == SC_AioRead || type == SC_AioWrite))
+    {
+      printf("syscall %s called\n", type == SC_AioRead ? "aioread" : "aiowrite");
+      int baseAddr = machine->ReadRegister(4);
+      int size = machine->ReadRegister(5);
+      int fileId = machine->ReadRegister(6);
+      if(type == SC_AioRead && fileId == ConsoleInput)
+        fileId = currentThread->stdIn;
+      if(type == SC_AioWrite && fileId == ConsoleOutput)
+        fileId = currentThread->stdOut;
+      int ticket = aioTable->Submit(type == SC_AioWrite, fileId, baseAddr, size);
+      machine->WriteRegister(2, ticket);
+      machine->AddPC();
+    }
+    else if(which == SyscallException && type == SC_AioWait)
+    {
+      printf("syscall aiowait called\n");
+      int ticket = machine->ReadRegister(4);
+      int poll = machine->ReadRegister(5);
+      machine->WriteRegister(2, aioTable->Wait(ticket, poll != 0));
+      machine->AddPC();
+    }
+    else if(which == SyscallException && type == SC_SpawnV)
+    {
+      printf("syscall spawnv called\n");
+      char *fileName = ReadUserString(machine->ReadRegister(4));
+      int argvAddr = machine->ReadRegister(5);
+      int stdIn = machine->ReadRegister(6);
+      int stdOut = machine->ReadRegister(7);
+      char *args[MaxSpawnArgs];
+      int argc = 0;
+      int argAddr;
+
+      // the child's ConsoleInput/ConsoleOutput are relative to ours
+      if(stdIn == ConsoleInput)
+        stdIn = currentThread->stdIn;
+      if(stdOut == ConsoleOutput)
+        stdOut = currentThread->stdOut;
+
+      while(argvAddr != 0 && argc < MaxSpawnArgs)
+      {
+        while(!machine->ReadMem(argvAddr + argc * 4, 4, &argAddr))
+          ;
+        if(argAddr == 0)
+          break;
+        args[argc++] = ReadUserString(argAddr);
+      }
+
+#ifdef FILESYS_STUB
+      OpenFile *executable = fileSystem->Open(fileName);
+#else
+      OpenFile *executable = fileSystem->Open("/", fileName);
+#endif
+      int retVal = -1;
+      if(executable == NULL)
+        printf("cannot open %s\n", fileName);
+      else
+      {
+        Thread *thread = new Thread(fileName);
+        char *swapName = new char[MaxArgLen + 16];
+        sprintf(swapName, "%s.%d", fileName, thread->getTid());
+        AddrSpace *space = new AddrSpace(executable, swapName);
+        delete executable;
+        delete [] swapName;
+
+        if(!space->PushArgs(argc, args))
+        {
+          printf("arguments to %s do not fit on its stack\n", fileName);
+          delete space;
+          threads[thread->getTid()] = NULL;	// never forked
+          FreeTid(thread->getTid());
+          delete thread;
+        }
+        else
+        {
+          thread->space = space;
+          thread->stdIn = stdIn;
+          thread->stdOut = stdOut;
+          pipeTable->Dup(stdIn, thread);
+          pipeTable->Dup(stdOut, thread);
+          retVal = thread->getTid();
+          thread->Fork(spawnProc, 0);
+        }
+      }
+      for(int i = 0; i < argc; i++)
+        delete [] args[i];
+      if(retVal < 0)
+        delete [] fileName;     // otherwise it names the new thread
+      machine->WriteRegister(2, retVal);
+      machine->AddPC();
+    }
     else 
     {
    	    if(which == IllegalInstrException && type == SC_Halt)
@@ -320,4 +532,63 @@ void forkProc(int funcAddr)
     currentThread->space->RestoreState(); // load page table register
     machine->Run(); // jump to the user progam
     ASSERT(FALSE); // machine->Run never returns;
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// spawnProc
+// 	First thing a thread made by SpawnV runs: start its new program.
+//	The arguments were already put on its stack by PushArgs.
+//----------------------------------------------------------------------
+
+void spawnProc(int arg)
+{
+    currentThread->space->InitRegisters();
+    currentThread->space->RestoreState();
+    machine->cleanTlb();
+    machine->Run(); // jump to the user progam
+    ASSERT(FALSE); // machine->Run never returns;
+}
+
+//----------------------------------------------------------------------
+// ExitProgram
+// 	End the current thread's program, because it called Exit or made
+//	a bad memory access: give up what it holds outside its address
+//	space, and finish the thread.  Does not return.
+//----------------------------------------------------------------------
+
+static void
+ExitProgram(int status)
+{
+    DEBUG('a', "Program %s exits with status %d\n",
+				currentThread->getName(), status);
+    pipeTable->CloseAll();		// includes stdIn and stdOut
+    shmTable->DetachAll(currentThread->space);
+    aioTable->ReleaseAll(currentThread->space);
+    currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// ReadUserString
+// 	Copy a null-terminated string out of the current address space
+//	into a new kernel buffer, which the caller must delete.  Strings
+//	longer than MaxArgLen - 1 characters are cut short.
+//----------------------------------------------------------------------
+
+static char *
+ReadUserString(int baseAddr)
+{
+    char *str = new char[MaxArgLen];
+    int readValue;
+    int i;
+
+    for(i = 0; i < MaxArgLen - 1; i++)
+    {
+      while(!machine->ReadMem(baseAddr + i, 1, &readValue))
+        ;     // the page fault is handled, try again
+      str[i] = (char)readValue;
+      if(readValue == 0)
+        break;
+    }
+    str[i] = '\0';
+    return str;
+}
@@ -0,0 +1,142 @@
+// futex.cc
+//	Routines to implement futex wait queues.  See futex.h.
+//
+//	The queues are manipulated with interrupts disabled.  FutexWait
+//	checks the lock word and goes to sleep without letting anyone else
+//	run in between, so a FutexWake that follows a change to the word
+//	can never be lost.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "futex.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// FutexTable::FutexTable
+// 	Initialize the table; initially nobody is waiting.
+//----------------------------------------------------------------------
+
+FutexTable::FutexTable()
+{
+    for (int i = 0; i < FutexBuckets; i++)
+	buckets[i] = new List;
+}
+
+//----------------------------------------------------------------------
+// FutexTable::~FutexTable
+// 	De-allocate the table.  Threads still waiting are never woken.
+//----------------------------------------------------------------------
+
+FutexTable::~FutexTable()
+{
+    for (int i = 0; i < FutexBuckets; i++)
+	delete buckets[i];
+}
+
+//----------------------------------------------------------------------
+// FutexTable::KeyOf
+// 	Work out the key of the word at "virtAddr" in the address space
+//	that is running now (see futex.h).  Return FALSE if "virtAddr" is
+//	not an aligned address inside the address space.
+//----------------------------------------------------------------------
+
+bool
+FutexTable::KeyOf(int virtAddr, PageTable **table, int *addr)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    TranslationEntry *entry;
+
+    if (virtAddr < 0 || (virtAddr & 3) != 0 || vpn >= machine->pageTableSize)
+	return FALSE;
+    entry = &machine->pageTable[vpn];
+    if (entry->shared) {
+	*table = NULL;
+	*addr = entry->physicalPage * PageSize + virtAddr % PageSize;
+    } else {
+	*table = currentThread->space->GetPageTable();
+	*addr = virtAddr;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FutexTable::Wait
+// 	If the word at "virtAddr" still holds "expected", put the current
+//	thread to sleep until a FutexWake on the same word.  Return 0
+//	after sleeping, or -1 straight away if the word held something
+//	else (the lock changed hands, so the caller should look again).
+//
+//	Reading the word can page fault, and paging in waits for the
+//	disk, so the word is read with interrupts still on.  No simulated
+//	time passes between a successful read and disabling interrupts,
+//	so nobody else can change the word in between.
+//----------------------------------------------------------------------
+
+int
+FutexTable::Wait(int virtAddr, int expected)
+{
+    FutexWaiter waiter;
+    IntStatus oldLevel;
+    int value;
+
+    if (!KeyOf(virtAddr, &waiter.table, &waiter.addr))
+	return -1;
+    while (!machine->ReadMem(virtAddr, 4, &value))
+	;			// the page fault is handled, try again
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    if (value != expected) {
+	(void) interrupt->SetLevel(oldLevel);
+	return -1;
+    }
+    waiter.sleep = new Semaphore("futex", 0);
+    buckets[(unsigned) waiter.addr / 4 % FutexBuckets]->Append(&waiter);
+    DEBUG('a', "Thread %s waits on futex at 0x%x\n",
+				currentThread->getName(), virtAddr);
+    waiter.sleep->P();		// FutexWake takes us off the queue
+    (void) interrupt->SetLevel(oldLevel);
+    delete waiter.sleep;
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// FutexTable::Wake
+// 	Wake up to "count" threads waiting on the word at "virtAddr",
+//	oldest first.  Return the number of threads woken.
+//
+//	The chain is emptied and the waiters that stay asleep are put
+//	back in their old order, since List cannot remove from the middle.
+//----------------------------------------------------------------------
+
+int
+FutexTable::Wake(int virtAddr, int count)
+{
+    PageTable *table;
+    FutexWaiter *waiter;
+    List *chain, *keep;
+    int addr, woken = 0;
+    IntStatus oldLevel;
+
+    if (!KeyOf(virtAddr, &table, &addr))
+	return -1;
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    chain = buckets[(unsigned) addr / 4 % FutexBuckets];
+    keep = new List;
+    while ((waiter = (FutexWaiter *) chain->Remove()) != NULL) {
+	if (woken < count && waiter->table == table && waiter->addr == addr) {
+	    waiter->sleep->V();
+	    woken++;
+	} else
+	    keep->Append(waiter);
+    }
+    while ((waiter = (FutexWaiter *) keep->Remove()) != NULL)
+	chain->Append(waiter);
+    (void) interrupt->SetLevel(oldLevel);
+    delete keep;
+    DEBUG('a', "Woke %d threads on futex at 0x%x\n", woken, virtAddr);
+    return woken;
+}
@@ -0,0 +1,71 @@
+// futex.h
+//	Data structures for futexes -- kernel wait queues that user
+//	programs use to build their own locks.
+//
+//	A user-level lock lives in an ordinary word of user memory and is
+//	taken and released with AtomicCas (see start.s) without entering
+//	the kernel.  Only when a thread has to wait does it call FutexWait,
+//	and only when a waiter might exist does the releasing thread call
+//	FutexWake.
+//
+//	Waiters are kept in a hash table.  A word in a shared memory
+//	segment (cf. shm.h) is keyed on its *physical* address, so that
+//	threads in different address spaces find the same queue; those
+//	pages never move.  Any other page can be paged out and come back
+//	in a different frame while somebody sleeps on it, so a private
+//	word is keyed on (page table, virtual address) instead -- threads
+//	made by Fork share their parent's page table, and so its futexes.
+//	The key is the PageTable object, which stays the same when a
+//	segment mapping moves the entries to a bigger array.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "copyright.h"
+#include "list.h"
+#include "synch.h"
+#include "translate.h"
+
+#define FutexBuckets 	16	// number of hash chains
+
+class PageTable;
+
+// The following class defines one thread sleeping in FutexWait.  The
+// word it waits on is named by "table" and "addr": "table" is NULL for a
+// word in shared memory, and "addr" is then a physical address.
+
+class FutexWaiter {
+  public:
+    PageTable *table;			// page table the word is private to
+    int addr;				// address of the word
+    Semaphore *sleep;			// the waiting thread sleeps here
+};
+
+// The following class defines the table of futex wait queues.
+
+class FutexTable {
+  public:
+    FutexTable();
+    ~FutexTable();
+
+    int Wait(int virtAddr, int expected);	// Sleep on the word at
+					// "virtAddr" if it still holds
+					// "expected"; return 0 once woken,
+					// -1 if the value had changed
+    int Wake(int virtAddr, int count);	// Wake up to "count" threads
+					// sleeping on the word at "virtAddr";
+					// return how many were woken
+
+  private:
+    List *buckets[FutexBuckets];	// waiters, hashed on FutexWaiter::addr
+
+    bool KeyOf(int virtAddr, PageTable **table, int *addr);
+					// Name the word at "virtAddr" in
+					// the current address space
+};
+
+#endif // FUTEX_H
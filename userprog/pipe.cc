@@ -0,0 +1,296 @@
+// pipe.cc
+//	Routines to implement pipes between user programs.  See pipe.h
+//	for the semantics.
+//
+//	Each pipe is protected by its own lock; readers and writers
+//	wait on two condition variables, one for "something to read"
+//	and one for "room to write".  Since Nachos condition variables
+//	are Mesa-style, every wait is in a loop that re-checks the
+//	condition after waking up.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "pipe.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// KernelPipe::KernelPipe
+// 	Initialize an empty pipe.  The creator holds one reference to
+//	each end.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+KernelPipe::KernelPipe(char *debugName)
+{
+    name = debugName;
+    head = 0;
+    count = 0;
+    readers = 1;
+    writers = 1;
+    lock = new Lock("pipe lock");
+    notEmpty = new Condition("pipe not empty");
+    notFull = new Condition("pipe not full");
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::~KernelPipe
+// 	De-allocate a pipe.  Assume nobody is still waiting on it.
+//----------------------------------------------------------------------
+
+KernelPipe::~KernelPipe()
+{
+    delete lock;
+    delete notEmpty;
+    delete notFull;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Read
+// 	Read up to "numBytes" bytes out of the pipe.  Wait until at
+//	least one byte is buffered, or until there are no writers left.
+//	Return the number of bytes read; 0 means end of file.
+//
+//	"into" -- the kernel buffer to hold the bytes
+//	"numBytes" -- the most bytes to read
+//----------------------------------------------------------------------
+
+int
+KernelPipe::Read(char *into, int numBytes)
+{
+    int i;
+
+    if (numBytes <= 0)
+	return 0;
+    lock->Acquire();
+    while (count == 0 && writers > 0)
+	notEmpty->Wait(lock);
+    if (numBytes > count)
+	numBytes = count;
+    for (i = 0; i < numBytes; i++) {
+	into[i] = buffer[head];
+	head = (head + 1) % PipeBufferSize;
+    }
+    count -= numBytes;
+    if (numBytes > 0)
+	notFull->Broadcast(lock);
+    lock->Release();
+    DEBUG('a', "Pipe %s: read %d bytes, %d left\n", name, numBytes, count);
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Write
+// 	Write "numBytes" bytes into the pipe, waiting for room as needed.
+//	Return the number of bytes written, or -1 if every read end
+//	was closed before anything could be written.
+//
+//	"from" -- the kernel buffer holding the bytes
+//	"numBytes" -- the number of bytes to write
+//----------------------------------------------------------------------
+
+int
+KernelPipe::Write(char *from, int numBytes)
+{
+    int done = 0;
+    int tail;
+
+    lock->Acquire();
+    while (done < numBytes) {
+	while (count == PipeBufferSize && readers > 0)
+	    notFull->Wait(lock);
+	if (readers == 0)		// nobody will ever read this
+	    break;
+	while (done < numBytes && count < PipeBufferSize) {
+	    tail = (head + count) % PipeBufferSize;
+	    buffer[tail] = from[done++];
+	    count++;
+	}
+	notEmpty->Broadcast(lock);
+    }
+    lock->Release();
+    DEBUG('a', "Pipe %s: wrote %d of %d bytes\n", name, done, numBytes);
+    if (done == 0 && numBytes > 0)
+	return -1;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::OpenEnd/CloseEnd
+// 	Keep track of how many holders each end of the pipe has.  When
+//	the last writer goes away, waiting readers see end of file; when
+//	the last reader goes away, waiting writers give up.
+//
+//	"writing" -- TRUE for the write end, FALSE for the read end
+//----------------------------------------------------------------------
+
+void
+KernelPipe::OpenEnd(bool writing)
+{
+    lock->Acquire();
+    if (writing)
+	writers++;
+    else
+	readers++;
+    lock->Release();
+}
+
+void
+KernelPipe::CloseEnd(bool writing)
+{
+    lock->Acquire();
+    if (writing) {
+	ASSERT(writers > 0);
+	if (--writers == 0)
+	    notEmpty->Broadcast(lock);
+    } else {
+	ASSERT(readers > 0);
+	if (--readers == 0)
+	    notFull->Broadcast(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// PipeTable::PipeTable
+// 	Initialize the table of pipes; initially there are none, and
+//	nobody holds anything.
+//----------------------------------------------------------------------
+
+PipeTable::PipeTable()
+{
+    for (int i = 0; i < MaxPipes; i++)
+	pipes[i] = NULL;
+    held = new char[MAX_THREAD_NUM * 2 * MaxPipes];
+    for (int i = 0; i < MAX_THREAD_NUM * 2 * MaxPipes; i++)
+	held[i] = 0;
+}
+
+PipeTable::~PipeTable()
+{
+    for (int i = 0; i < MaxPipes; i++)
+	delete pipes[i];
+    delete [] held;
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Create
+// 	Make a new pipe, and return the OpenFileIds of its read and
+//	write ends, both held by the current thread.  Return FALSE if
+//	too many pipes are open.
+//----------------------------------------------------------------------
+
+bool
+PipeTable::Create(int *readFd, int *writeFd)
+{
+    char *ours = held + currentThread->getTid() * 2 * MaxPipes;
+
+    for (int i = 0; i < MaxPipes; i++)
+	if (pipes[i] == NULL) {
+	    pipes[i] = new KernelPipe("user pipe");
+	    *readFd = PipeFdBase + 2 * i;
+	    *writeFd = PipeFdBase + 2 * i + 1;
+	    ours[2 * i] = 1;
+	    ours[2 * i + 1] = 1;
+	    return TRUE;
+	}
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// PipeTable::IsPipe
+// 	Return TRUE if "fd" is one end of a pipe that is still open.
+//----------------------------------------------------------------------
+
+bool
+PipeTable::IsPipe(int fd)
+{
+    int which = (fd - PipeFdBase) / 2;
+
+    if (fd < PipeFdBase || which >= MaxPipes)
+	return FALSE;
+    return pipes[which] != NULL;
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Read/Write
+// 	Transfer bytes through the pipe named by "fd".  Reading from
+//	a write end, or writing to a read end, is an error (-1).
+//----------------------------------------------------------------------
+
+int
+PipeTable::Read(int fd, char *into, int numBytes)
+{
+    if (!IsPipe(fd) || (fd - PipeFdBase) % 2 != 0)
+	return -1;
+    return pipes[(fd - PipeFdBase) / 2]->Read(into, numBytes);
+}
+
+int
+PipeTable::Write(int fd, char *from, int numBytes)
+{
+    if (!IsPipe(fd) || (fd - PipeFdBase) % 2 != 1)
+	return -1;
+    return pipes[(fd - PipeFdBase) / 2]->Write(from, numBytes);
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Dup/Close
+// 	Add or drop a reference to one end of a pipe.  Once both ends
+//	have no references left, the pipe is de-allocated.
+//
+//	Close only drops a reference the current thread holds, so closing
+//	an end twice, or closing an end we never had, does nothing and
+//	returns FALSE.
+//
+//	"holder" -- the thread that is given the new reference
+//----------------------------------------------------------------------
+
+void
+PipeTable::Dup(int fd, Thread *holder)
+{
+    if (!IsPipe(fd))
+	return;
+    pipes[(fd - PipeFdBase) / 2]->OpenEnd((fd - PipeFdBase) % 2 == 1);
+    held[holder->getTid() * 2 * MaxPipes + fd - PipeFdBase]++;
+}
+
+bool
+PipeTable::Close(int fd)
+{
+    int which = (fd - PipeFdBase) / 2;
+    char *ours = held + currentThread->getTid() * 2 * MaxPipes;
+
+    if (!IsPipe(fd) || ours[fd - PipeFdBase] == 0) {
+	DEBUG('a', "Thread %s does not hold pipe end %d\n",
+					currentThread->getName(), fd);
+	return FALSE;
+    }
+    ours[fd - PipeFdBase]--;
+    pipes[which]->CloseEnd((fd - PipeFdBase) % 2 == 1);
+    if (pipes[which]->IsClosed()) {
+	delete pipes[which];
+	pipes[which] = NULL;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PipeTable::CloseAll
+// 	Drop every reference the current thread still holds, because
+//	it is exiting.  Readers waiting on a pipe only this thread was
+//	writing to see end of file.
+//----------------------------------------------------------------------
+
+void
+PipeTable::CloseAll()
+{
+    char *ours = held + currentThread->getTid() * 2 * MaxPipes;
+
+    for (int end = 0; end < 2 * MaxPipes; end++)
+	while (ours[end] > 0)
+	    Close(PipeFdBase + end);
+}
@@ -0,0 +1,88 @@
+// pipe.h
+//	Data structures for in-kernel pipes between user programs.
+//
+//	A pipe is a bounded ring buffer of bytes, with one end for
+//	reading and one end for writing.  A reader waits while the buffer
+//	is empty, and a writer waits while it is full.  Nothing here ever
+//	goes near the disk; the bytes only live in kernel memory.
+//
+//	Pipe ends are handed to user programs as ordinary OpenFileIds,
+//	taken from a range above the ids used by the file system, so that
+//	Read/Write/Close can tell the two apart.  The table also counts
+//	the references each thread holds on each end, so that closing an
+//	end twice is harmless, and so that whatever a thread still holds
+//	when it exits can be closed for it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "synch.h"
+
+#define PipeBufferSize 	256	// bytes buffered in each pipe
+#define MaxPipes 	16	// pipes that can be open at once
+#define PipeFdBase 	64	// first OpenFileId used for pipe ends;
+				// pipe i owns ids PipeFdBase + 2*i (read)
+				// and PipeFdBase + 2*i + 1 (write)
+
+// The following class defines a single pipe.  Read returns as soon as
+// at least one byte is available, like a UNIX pipe; it only returns 0
+// once the buffer is empty and every write end has been closed.
+// Write blocks until all of its bytes have been buffered, and returns -1
+// if there are no readers left to consume them.
+
+class KernelPipe {
+  public:
+    KernelPipe(char *debugName);	// Initialize an empty pipe, with
+					// one read end and one write end
+    ~KernelPipe();
+
+    int Read(char *into, int numBytes);	// Read up to "numBytes" bytes
+    int Write(char *from, int numBytes);	// Write all of "numBytes" bytes
+
+    void OpenEnd(bool writing);		// Another holder of one end
+    void CloseEnd(bool writing);	// A holder of one end is done
+    bool IsClosed() { return (readers == 0) && (writers == 0); }
+
+  private:
+    char *name;
+    char buffer[PipeBufferSize];	// the ring buffer
+    int head;				// index of the next byte to read
+    int count;				// number of bytes buffered
+    int readers;			// open read ends
+    int writers;			// open write ends
+    Lock *lock;				// protects everything above
+    Condition *notEmpty;		// readers wait here
+    Condition *notFull;			// writers wait here
+};
+
+// The following class maps pipe OpenFileIds to pipes.
+
+class PipeTable {
+  public:
+    PipeTable();
+    ~PipeTable();
+
+    bool Create(int *readFd, int *writeFd);	// Make a new pipe, return
+						// its two ends
+    bool IsPipe(int fd);		// Does "fd" name an open pipe end?
+    int Read(int fd, char *into, int numBytes);
+    int Write(int fd, char *from, int numBytes);
+    void Dup(int fd, Thread *holder);	// Give "holder" another reference
+					// to an end
+    bool Close(int fd);			// Drop one of our references to
+					// an end
+    void CloseAll();			// Drop every reference we hold
+
+  private:
+    KernelPipe *pipes[MaxPipes];
+    char *held;				// references each thread holds on
+					// each end, indexed by
+					// tid * 2 * MaxPipes + (fd - PipeFdBase)
+};
+
+#endif // PIPE_H
@@ -0,0 +1,214 @@
+// shm.cc
+//	Routines to manage shared memory segments.  See shm.h.
+//
+//	All of the bookkeeping here is done with interrupts disabled,
+//	since nothing in it ever waits.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "shm.h"
+#include "system.h"
+#include "addrspace.h"
+#ifdef HOST_SPARC
+#include <strings.h>
+#endif
+
+//----------------------------------------------------------------------
+// ShmTable::ShmTable
+// 	Initialize the table; initially there are no segments, and
+//	nothing is attached.
+//----------------------------------------------------------------------
+
+ShmTable::ShmTable()
+{
+    for (int i = 0; i < MaxShmSegments; i++)
+	segments[i].inUse = FALSE;
+    for (int i = 0; i < MaxShmAttach; i++)
+	attachSpace[i] = NULL;
+}
+
+ShmTable::~ShmTable()
+{
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Get
+// 	Return the id of the segment named "key", creating it if no
+//	such segment exists yet.  A new segment gets zero-filled frames
+//	straight out of "memoryBitmap".  Return -1 if the segment is too
+//	big, the table is full, or physical memory has run out.
+//
+//	"key" -- the user chosen name of the segment
+//	"size" -- the size of the segment in bytes, if it has to be created
+//	"space" -- the address space asking for it
+//----------------------------------------------------------------------
+
+int
+ShmTable::Get(int key, int size, AddrSpace *space)
+{
+    int numPages = divRoundUp(size, PageSize);
+    int id = -1;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    for (int i = 0; i < MaxShmSegments; i++)
+	if (segments[i].inUse && segments[i].key == key) {
+	    (void) interrupt->SetLevel(oldLevel);
+	    return i;
+	}
+
+    if (numPages <= 0 || numPages > MaxShmPages
+		|| memoryBitmap->NumClear() < numPages) {
+	(void) interrupt->SetLevel(oldLevel);
+	return -1;
+    }
+    for (int i = 0; i < MaxShmSegments; i++)
+	if (!segments[i].inUse) {
+	    id = i;
+	    break;
+	}
+    if (id != -1) {
+	ShmSegment *seg = &segments[id];
+	seg->inUse = TRUE;
+	seg->key = key;
+	seg->numPages = numPages;
+	seg->refCount = 0;
+	seg->creator = space;
+	for (int i = 0; i < numPages; i++) {
+	    seg->frames[i] = memoryBitmap->Find();
+	    bzero(&(machine->mainMemory[seg->frames[i] * PageSize]), PageSize);
+	}
+	DEBUG('a', "Created shared segment %d, key %d, %d pages\n",
+			id, key, numPages);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Attach
+// 	Map segment "id" into "space", after the pages it already has.
+//	Return the virtual address of the first byte of the segment.
+//----------------------------------------------------------------------
+
+int
+ShmTable::Attach(int id, AddrSpace *space)
+{
+    int slot = -1;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (id < 0 || id >= MaxShmSegments || !segments[id].inUse) {
+	(void) interrupt->SetLevel(oldLevel);
+	return -1;
+    }
+    for (int i = 0; i < MaxShmAttach; i++)
+	if (attachSpace[i] == NULL) {
+	    slot = i;
+	    break;
+	}
+    if (slot == -1) {
+	(void) interrupt->SetLevel(oldLevel);
+	return -1;
+    }
+
+    attachSpace[slot] = space;
+    attachSegment[slot] = id;
+    attachPage[slot] = space->MapShared(segments[id].frames,
+					segments[id].numPages);
+    segments[id].refCount++;
+    (void) interrupt->SetLevel(oldLevel);
+    return attachPage[slot] * PageSize;
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Detach
+// 	Unmap the segment attached at "virtAddr" in "space".  Return
+//	FALSE if no segment is attached there.
+//----------------------------------------------------------------------
+
+bool
+ShmTable::Detach(int virtAddr, AddrSpace *space)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    for (int i = 0; i < MaxShmAttach; i++)
+	if (attachSpace[i] == space && attachPage[i] * PageSize == virtAddr) {
+	    int id = attachSegment[i];
+
+	    space->UnmapShared(attachPage[i], segments[id].numPages);
+	    attachSpace[i] = NULL;
+	    Release(id);
+	    (void) interrupt->SetLevel(oldLevel);
+	    return TRUE;
+	}
+    (void) interrupt->SetLevel(oldLevel);
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// ShmTable::DetachAll
+// 	Drop every segment attached to "space", whose program is exiting
+//	or which is about to be de-allocated.  The segments are unmapped
+//	too: the page table may be shared with threads Fork made, which
+//	go on running.
+//
+//	Segments "space" created that nobody ever attached are freed
+//	too; otherwise nothing would ever free them.
+//----------------------------------------------------------------------
+
+void
+ShmTable::DetachAll(AddrSpace *space)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    for (int i = 0; i < MaxShmAttach; i++)
+	if (attachSpace[i] == space) {
+	    space->UnmapShared(attachPage[i],
+				segments[attachSegment[i]].numPages);
+	    attachSpace[i] = NULL;
+	    Release(attachSegment[i]);
+	}
+    for (int i = 0; i < MaxShmSegments; i++)
+	if (segments[i].inUse && segments[i].creator == space) {
+	    segments[i].creator = NULL;		// the pointer may be reused
+	    if (segments[i].refCount == 0)
+		Free(i);
+	}
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Release
+// 	Drop one reference to segment "id"; when the last one goes,
+//	give its frames back to physical memory.  Interrupts are
+//	already off.
+//----------------------------------------------------------------------
+
+void
+ShmTable::Release(int id)
+{
+    ShmSegment *seg = &segments[id];
+
+    ASSERT(seg->refCount > 0);
+    if (--seg->refCount == 0)
+	Free(id);
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Free
+// 	Give the frames of segment "id" back to physical memory, and
+//	mark the slot free.  Interrupts are already off.
+//----------------------------------------------------------------------
+
+void
+ShmTable::Free(int id)
+{
+    ShmSegment *seg = &segments[id];
+
+    for (int i = 0; i < seg->numPages; i++)
+	memoryBitmap->Clear(seg->frames[i]);
+    seg->inUse = FALSE;
+    DEBUG('a', "Released shared segment %d\n", id);
+}
@@ -0,0 +1,77 @@
+// shm.h
+//	Data structures for shared memory segments between user programs.
+//
+//	A segment is a set of physical page frames, named by a user
+//	chosen integer key.  Attaching a segment maps the same frames
+//	into the page table of the calling address space, so that every
+//	process that attached it sees the same bytes, with no copying.
+//
+//	Each segment counts how many address spaces have it attached;
+//	its frames go back to "memoryBitmap" when the last one detaches.
+//	A segment nobody has attached yet is freed when the address space
+//	that created it goes away.
+//	Shared pages are never picked for page replacement: the swap file
+//	belongs to one address space, and cannot back a frame that several
+//	address spaces map.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SHM_H
+#define SHM_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define MaxShmSegments 	8	// segments that can exist at once
+#define MaxShmPages 	8	// largest segment, in pages
+#define MaxShmAttach 	32	// (segment, address space) mappings
+
+class AddrSpace;
+
+// The following class defines one shared memory segment.
+
+class ShmSegment {
+  public:
+    bool inUse;			// Is this slot a live segment?
+    int key;			// user chosen name of the segment
+    int numPages;		// size of the segment
+    int frames[MaxShmPages];	// physical pages holding the segment
+    int refCount;		// address spaces that have it attached
+    AddrSpace *creator;		// address space that created it
+};
+
+// The following class defines the table of all shared memory segments,
+// and the record of where each one is attached.
+
+class ShmTable {
+  public:
+    ShmTable();
+    ~ShmTable();
+
+    int Get(int key, int size, AddrSpace *space);
+					// Find or create, for "space", the
+					// segment named "key"; return its
+					// id, or -1
+    int Attach(int id, AddrSpace *space);	// Map a segment into "space";
+					// return its virtual address, or -1
+    bool Detach(int virtAddr, AddrSpace *space);
+					// Unmap the segment attached at
+					// "virtAddr" in "space"
+    void DetachAll(AddrSpace *space);	// Called when "space" goes away
+
+  private:
+    ShmSegment segments[MaxShmSegments];
+
+    // One record per attachment, so that Detach can find the segment
+    // from the address alone.
+    AddrSpace *attachSpace[MaxShmAttach];
+    int attachSegment[MaxShmAttach];
+    int attachPage[MaxShmAttach];	// first virtual page of the mapping
+
+    void Release(int id);		// Drop one reference to a segment
+    void Free(int id);			// Give a segment's frames back
+};
+
+#endif // SHM_H
@@ -29,6 +29,25 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_Pipe		11
+#define SC_ShmGet	12
+#define SC_ShmAttach	13
+#define SC_ShmDetach	14
+#define SC_FutexWait	15
+#define SC_FutexWake	16
+#define SC_SpawnV	17
+#define SC_AioRead	18
+#define SC_AioWrite	19
+#define SC_AioWait	20
+
+/* AtomicCas (see start.s) is a restartable sequence at a fixed address.
+ * A thread that is switched out with its PC past the first instruction
+ * and no further than the store is put back at the first instruction,
+ * so the compare and the swap always happen in one go.  Programs built
+ * with an older start.s, which has other code there, are left alone.
+ */
+#define AtomicCasStart	16
+#define AtomicCasStore	32
 
 #ifndef IN_ASM
 
@@ -108,6 +127,88 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* Create a pipe: a bounded buffer in the kernel, with a read end and a
+ * write end.  On success, fds[0] is the read end and fds[1] the write
+ * end, and 0 is returned; -1 is returned if too many pipes are open.
+ * Read and Write work on the ends like on any open file, but never touch
+ * the disk.  Read waits until at least one byte is available, and returns
+ * 0 once every write end has been closed.
+ */
+int Pipe(OpenFileId *fds);
+
+/* Run the executable "name" as a new program alongside this one, and
+ * return its address space identifier, or -1.  The new program starts
+ * as main(argc, argv) with a copy of "argv", a NULL-terminated array of
+ * strings (at most 8, each cut short at 63 characters).  Its ConsoleInput
+ * and ConsoleOutput are "stdIn" and "stdOut" of this program -- usually
+ * ConsoleInput/ConsoleOutput themselves, or the ends of a Pipe.
+ */
+SpaceId SpawnV(char *name, char **argv, OpenFileId stdIn, OpenFileId stdOut);
+
+/* Asynchronous I/O: AioRead, AioWrite, AioWait.
+ * AioRead and AioWrite queue a transfer of up to 1024 bytes and return
+ * a ticket straight away (-1 if too many are outstanding), while the
+ * kernel does the I/O in the background.  Transfers happen one at a
+ * time, in the order they were queued.  An AioWrite copies "buffer"
+ * before it returns; an AioRead only fills "buffer" during AioWait.
+ */
+int AioRead(char *buffer, int size, OpenFileId id);
+int AioWrite(char *buffer, int size, OpenFileId id);
+
+/* Return the number of bytes the transfer "ticket" moved, or -1, after
+ * waiting for it to finish.  If "poll" is non-zero and the transfer is
+ * still going on, return AioPending at once instead; the ticket stays
+ * valid until AioWait has returned its result.
+ */
+#define AioPending	-2
+int AioWait(int ticket, int poll);
+
+
+/* Shared memory operations: ShmGet, ShmAttach, ShmDetach.
+ * A segment is a set of physical pages, named by an integer "key" that
+ * cooperating programs agree on.  Every program that attaches the segment
+ * sees the same memory, so data put there is never copied by the kernel.
+ */
+
+/* A unique identifier for a shared memory segment. */
+typedef int ShmId;
+
+/* Return the segment named "key", creating it with "size" bytes of zeroed
+ * memory if it does not exist yet.  Return -1 on failure.
+ */
+ShmId ShmGet(int key, int size);
+
+/* Map segment "id" into this address space, and return the address of its
+ * first byte, or 0 on failure.
+ */
+char *ShmAttach(ShmId id);
+
+/* Unmap the segment attached at "addr".  Once no address space has a
+ * segment attached any more, its memory is freed.
+ */
+int ShmDetach(char *addr);
+
+
+/* User-level synchronization: AtomicCas, FutexWait, FutexWake.
+ * A lock is an int in user memory.  It is taken and released with
+ * AtomicCas alone when nobody else wants it, and only a thread that has
+ * to wait, or that has to wake a waiter, traps into the kernel.
+ */
+
+/* If "*addr" holds "old", replace it with "val".  Either way, return
+ * the value "*addr" held before.  Runs entirely in user mode.
+ */
+int AtomicCas(int *addr, int old, int val);
+
+/* If "*addr" still holds "expected", sleep until a FutexWake on "addr".
+ * Return 0 after sleeping, -1 if "*addr" held something else.
+ */
+int FutexWait(int *addr, int expected);
+
+/* Wake up to "count" threads sleeping on "addr", and return how many
+ * were woken.
+ */
+int FutexWake(int *addr, int count);
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple